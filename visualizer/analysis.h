@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "band_map.h"
+#include "beat.h"
+#include "config.h"
+#include "kernels.h"
+#include "loudness.h"
+#include "sample_ring.h"
+#include "spectrum.h"
+
+// Everything between the capture ring and the renderer: drains the ring,
+// runs the spectrum and the beat detector and maps the spectrum to per-bar
+// levels. Has no GTK dependency so the headless bench drives exactly the
+// code the widget does.
+//
+// With automatic gain the bars are scaled by how far the short-term loudness
+// is from kTargetLufs, so quiet and loud masters both use the full height.
+// The level meter (Peaks) has no audio to measure and stays unscaled.
+//
+// In the mirror layout each half of the bars gets its own channel's spectrum,
+// low frequencies meeting in the center. The channels are split while
+// deinterleaving and both are transformed once per update, which costs about
+// what a single mixdown transform per hop did before transforms went lazy.
+//
+// The scope view also wants the waveform itself: for it the analyzer keeps
+// a ring of the newest kWaveFrames of mono mixdown as it drains the ring.
+class Analyzer {
+public:
+    struct Stats {
+        uint64_t updates;
+        double last_us; // cost of the most recent update()
+        double avg_us;
+        double max_us;
+    };
+
+    Analyzer(const VisualizerConfig& config, CaptureProfile profile, unsigned rate, unsigned channels)
+        : mirrored(config.layout == BarLayout::Mirror && profile != CaptureProfile::Peaks),
+          bar_count(mirrored ? std::max(2, config.bars & ~1) : config.bars),
+          channels(channels), frame_ns(1000000000.0 / rate), slice_frames(std::max(1u, rate / kPeakRate)),
+          targets(bar_count, 0.0f), scratch(kScratchFrames * channels),
+          wave(config.mode == ViewMode::Scope ? kWaveFrames : 0, 0.0f) {
+        // Peak-detect capture carries levels only, so there is no spectrum to
+        // take; otherwise keep the window near 46 ms whatever the rate.
+        if (profile != CaptureProfile::Peaks) {
+            size_t fft_size = rate >= 32000 ? 2048 : 1024;
+            spectrum = std::make_unique<SpectrumAnalyzer>(fft_size, fft_size / 4, channels, rate,
+                                                          SpectrumAnalyzer::Window::Hann, mirrored);
+            mapper = std::make_unique<BandMapper>(fft_size, rate, mirrored ? bar_count / 2 : bar_count,
+                                                  config.scale);
+            beats = std::make_unique<BeatDetector>(rate, channels);
+            loudness = std::make_unique<LoudnessMeter>(rate, channels);
+            auto_gain = config.auto_gain;
+        }
+    }
+
+    // Feeds everything captured since the last call through the analysis.
+    // Returns true when levels() changed.
+    bool update(SampleRing& ring) {
+        int64_t start = steady_now_ns();
+        float max_val = 0.0f;
+        size_t transforms = 0, consumed = 0, pushed = 0;
+        size_t n;
+        do {
+            int64_t stamp;
+            n = ring.read(scratch.data(), kScratchFrames, &stamp);
+            if (n > 0) newest_arrival = stamp + (int64_t)(n * frame_ns);
+            consumed += n;
+            max_val = std::max(max_val, peak_kernels.abs_peak(scratch.data(), n * channels));
+            if (spectrum) transforms += spectrum->feed(scratch.data(), n);
+            if (!spectrum) pushed += push_levels(scratch.data(), n);
+            if (beats) beats->feed(scratch.data(), n);
+            if (loudness) loudness->feed(scratch.data(), n);
+            if (!wave.empty()) keep_wave(n);
+        } while (n == kScratchFrames && ring.available() > 0);
+        current_peak = max_val;
+        if (auto_gain) follow_loudness(consumed * frame_ns / 1e9);
+
+        bool changed = true;
+        if (transforms > 0 && mirrored) {
+            // Mono capture has one spectrum, which then mirrors itself.
+            const int side = bar_count / 2;
+            mapper->map(spectrum->magnitudes(0), targets.data());
+            std::reverse(targets.begin(), targets.begin() + side);
+            mapper->map(spectrum->magnitudes(spectrum->get_outputs() - 1), targets.data() + side);
+            for (int i = 0; i < bar_count; ++i) targets[i] = db_level(targets[i]);
+        } else if (transforms > 0) {
+            mapper->map(spectrum->magnitudes(), targets.data());
+            for (int i = 0; i < bar_count; ++i) targets[i] = db_level(targets[i]);
+        } else if (!spectrum) {
+            changed = pushed > 0;
+        } else {
+            changed = false;
+        }
+
+        finished = steady_now_ns();
+        started = start;
+        double us = (finished - start) / 1000.0;
+        stats.last_us = us;
+        stats.avg_us = stats.updates ? stats.avg_us * 0.95 + us * 0.05 : us;
+        stats.max_us = std::max(stats.max_us, us);
+        ++stats.updates;
+        return changed;
+    }
+
+    // Bars actually produced: the mirror layout needs an even count.
+    int get_bar_count() const { return bar_count; }
+    // Per-bar levels in 0..1 from the latest spectrum (or level history).
+    const std::vector<float>& levels() const { return targets; }
+    // Sample peak of everything consumed by the last update().
+    float peak() const { return current_peak; }
+
+    static constexpr size_t kWaveFrames = 1 << 16; // covers Scope::kMaxHistory
+
+    // The newest count (at most kWaveFrames) frames of mono mixdown, oldest
+    // first. Zeros unless the config asked for the scope view.
+    void waveform(float* out, size_t count) const {
+        count = std::min(count, kWaveFrames);
+        if (wave.empty()) {
+            std::fill(out, out + count, 0.0f);
+            return;
+        }
+        size_t from = (wave_pos - count) & (kWaveFrames - 1);
+        size_t first = std::min(count, kWaveFrames - from);
+        std::copy(wave.begin() + from, wave.begin() + from + first, out);
+        std::copy(wave.begin(), wave.begin() + (count - first), out + first);
+    }
+
+    // Steady-clock times of the last update()'s start and end, and when the
+    // newest frame it has consumed so far was delivered to the ring (0 until
+    // audio arrives). The ring stamps a frame one frame-time before its
+    // fragment was pushed, hence the extra frame.
+    int64_t update_started_ns() const { return started; }
+    int64_t update_finished_ns() const { return finished; }
+    int64_t newest_arrival_ns() const { return newest_arrival; }
+
+    Stats get_stats() const { return stats; }
+    const SpectrumAnalyzer* get_spectrum() const { return spectrum.get(); }
+    // Onsets, beats and tempo; null for level-only (Peaks) capture.
+    const BeatDetector* get_beats() const { return beats.get(); }
+    // Momentary/short-term loudness; null for level-only (Peaks) capture.
+    const LoudnessMeter* get_loudness() const { return loudness.get(); }
+    // Gain currently applied to the bars, in dB.
+    float get_gain_db() const { return gain_db; }
+
+private:
+    static constexpr size_t kScratchFrames = 2048;
+    static constexpr float kFloorDb = -70.0f;
+    static constexpr double kTargetLufs = -14.0;
+    static constexpr double kMinGainDb = -12.0, kMaxGainDb = 24.0;
+    static constexpr double kGainTauS = 1.3; // time constant of the gain easing
+
+    bool mirrored;
+    int bar_count;
+    unsigned channels;
+    double frame_ns;
+    size_t slice_frames;    // frames per level meter column, 1/kPeakRate s
+    size_t slice_fill = 0;  // of the column being collected
+    float slice_peak = 0.0f;
+    std::vector<float> targets;
+    std::vector<float> scratch;
+    std::vector<float> wave; // mono ring for waveform(), empty when unused
+    size_t wave_pos = 0;     // next frame written
+    std::unique_ptr<SpectrumAnalyzer> spectrum;
+    std::unique_ptr<BandMapper> mapper;
+    std::unique_ptr<BeatDetector> beats;
+    std::unique_ptr<LoudnessMeter> loudness;
+    bool auto_gain = false;
+    float gain_db = 0.0f;
+    const kernels::Set& peak_kernels = kernels::best();
+    float current_peak = 0.0f;
+    int64_t started = 0, finished = 0, newest_arrival = 0;
+    Stats stats = {0, 0.0, 0.0, 0.0};
+
+    // Eases the gain towards the target over the seconds of audio just
+    // consumed, so the time constant holds at any update rate; silence holds
+    // it where it was rather than pumping the noise floor up.
+    void follow_loudness(double seconds) {
+        double lufs = loudness->short_term();
+        if (lufs <= LoudnessMeter::kSilenceLufs) return;
+        float target = (float)std::min(kMaxGainDb, std::max(kMinGainDb, kTargetLufs - lufs));
+        gain_db += (target - gain_db) * (float)(1.0 - std::exp(-seconds / kGainTauS));
+    }
+
+    // Level meter: one column per slice_frames of audio, however often
+    // update() runs, scrolling right to left with the newest on the right.
+    // Returns how many columns were pushed.
+    size_t push_levels(const float* frames, size_t n) {
+        size_t pushed = 0;
+        while (n > 0) {
+            size_t take = std::min(n, slice_frames - slice_fill);
+            slice_peak = std::max(slice_peak, peak_kernels.abs_peak(frames, take * channels));
+            frames += take * channels;
+            n -= take;
+            slice_fill += take;
+            if (slice_fill < slice_frames) break;
+            std::rotate(targets.begin(), targets.begin() + 1, targets.end());
+            targets.back() = db_level(slice_peak);
+            slice_fill = 0;
+            slice_peak = 0.0f;
+            ++pushed;
+        }
+        return pushed;
+    }
+
+    void keep_wave(size_t n) {
+        const float norm = 1.0f / channels;
+        for (size_t f = 0; f < n; ++f) {
+            float sum = 0.0f;
+            for (unsigned c = 0; c < channels; ++c) sum += scratch[f * channels + c];
+            wave[wave_pos] = sum * norm;
+            wave_pos = (wave_pos + 1) & (kWaveFrames - 1);
+        }
+    }
+
+    float db_level(float magnitude) const {
+        float db = 20.0f * std::log10(magnitude + 1e-9f) + gain_db;
+        return std::min(1.0f, std::max(0.0f, 1.0f - db / kFloorDb));
+    }
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+
+#include "capture.h"
+#include "config.h"
+#include "pulse_capture.h"
+#include "replay_capture.h"
+#include "signal_capture.h"
+#ifdef HAVE_PIPEWIRE
+#include "pipewire_capture.h"
+#endif
+
+// Picks the capture backend at startup. A replay or a configured source
+// replaces live capture; otherwise "auto" prefers native PipeWire when it was
+// compiled in and a daemon answers, and falls back to libpulse.
+inline std::unique_ptr<CaptureBackend> pick_capture(const VisualizerConfig& config) {
+    if (!config.replay.empty()) {
+        if (auto capture = ReplayCapture::create(config.replay, config.paced)) return capture;
+        std::cerr << "Falling back to live capture\n";
+    }
+    if (!config.source.empty()) {
+        if (auto capture = SignalCapture::create(config.source, config.capture, config.paced)) return capture;
+        std::cerr << "Falling back to live capture\n";
+    }
+#ifdef HAVE_PIPEWIRE
+    if (config.backend == CaptureBackendKind::Auto || config.backend == CaptureBackendKind::PipeWire) {
+        if (auto capture = PipeWireCapture::create(config.capture)) return capture;
+        if (config.backend == CaptureBackendKind::PipeWire) {
+            std::cerr << "PipeWire is not available, falling back to PulseAudio\n";
+        }
+    }
+#else
+    if (config.backend == CaptureBackendKind::PipeWire) {
+        std::cerr << "Built without PipeWire support, using PulseAudio\n";
+    }
+#endif
+    return std::make_unique<PulseCapture>(config.capture);
+}
+
+inline std::unique_ptr<CaptureBackend> open_capture(const VisualizerConfig& config) {
+    std::unique_ptr<CaptureBackend> capture = pick_capture(config);
+    if (!config.record.empty()) capture->record_to(config.record);
+    return capture;
+}
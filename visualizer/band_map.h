@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dsp_tables.h"
+
+enum class BandScale { Log, Mel };
+
+// Groups FFT bins into bars spaced logarithmically or on the Mel scale between
+// kMinHz and kMaxHz (or just under Nyquist for low capture rates). Every bar
+// owns at least one bin and every bin in range belongs to exactly one bar, so
+// aggregation is a single pass over the bins with no per-bar bounds checks.
+// (With more bars than bins in range the top bars come out empty rather than
+// overlapping.)
+//
+// Tables for the common FFT size / rate / bar count combinations are built at
+// compile time; anything else is computed once at construction.
+namespace band_map {
+
+constexpr double kMinHz = 40.0;
+constexpr double kMaxHz = 16000.0;
+
+constexpr double hz_to_mel(double hz) { return 2595.0 * dsp::log(1.0 + hz / 700.0) / dsp::kLn10; }
+constexpr double mel_to_hz(double mel) { return 700.0 * (dsp::exp(mel / 2595.0 * dsp::kLn10) - 1.0); }
+
+// Highest bar edge for a sample rate: kMaxHz, or a bit under Nyquist for
+// low-rate capture.
+constexpr double max_hz_for(unsigned rate) {
+    return rate * 0.45 < kMaxHz ? rate * 0.45 : kMaxHz;
+}
+
+constexpr double edge_hz(size_t i, size_t bands, BandScale scale, double max_hz) {
+    double t = (double)i / bands;
+    if (scale == BandScale::Log) {
+        return kMinHz * dsp::exp(t * dsp::log(max_hz / kMinHz));
+    }
+    double lo = hz_to_mel(kMinHz), hi = hz_to_mel(max_hz);
+    return mel_to_hz(lo + t * (hi - lo));
+}
+
+// edges must hold bands + 1 entries; bar i covers bins [edges[i], edges[i+1]).
+constexpr void fill_edges(uint16_t* edges, size_t fft_size, unsigned rate, size_t bands, BandScale scale) {
+    size_t last = fft_size / 2 + 1;
+    for (size_t i = 0; i <= bands; ++i) {
+        size_t bin = (size_t)(edge_hz(i, bands, scale, max_hz_for(rate)) * fft_size / rate + 0.5);
+        if (i > 0 && bin <= edges[i - 1]) bin = edges[i - 1] + 1;
+        edges[i] = (uint16_t)std::min(bin, last);
+    }
+}
+
+// bin_band holds fft_size / 2 + 1 entries; bins outside every bar map to
+// `bands` and are never read.
+constexpr void fill_bin_band(uint16_t* bin_band, const uint16_t* edges, size_t fft_size, size_t bands) {
+    for (size_t b = 0; b < fft_size / 2 + 1; ++b) bin_band[b] = (uint16_t)bands;
+    for (size_t i = 0; i < bands; ++i) {
+        for (size_t b = edges[i]; b < edges[i + 1]; ++b) bin_band[b] = (uint16_t)i;
+    }
+}
+
+template <size_t FftSize, unsigned Rate, size_t Bands, BandScale Scale>
+struct Table {
+    struct Data {
+        std::array<uint16_t, Bands + 1> edges;
+        std::array<uint16_t, FftSize / 2 + 1> bin_band;
+    };
+
+    static constexpr Data make() {
+        Data d{};
+        fill_edges(d.edges.data(), FftSize, Rate, Bands, Scale);
+        fill_bin_band(d.bin_band.data(), d.edges.data(), FftSize, Bands);
+        return d;
+    }
+
+    static constexpr Data data = make();
+};
+
+struct View {
+    const uint16_t* edges;
+    const uint16_t* bin_band;
+};
+
+template <size_t FftSize, unsigned Rate, size_t Bands, BandScale Scale>
+constexpr View view() {
+    return {Table<FftSize, Rate, Bands, Scale>::data.edges.data(),
+            Table<FftSize, Rate, Bands, Scale>::data.bin_band.data()};
+}
+
+template <size_t FftSize, unsigned Rate, size_t Bands>
+constexpr View view(BandScale scale) {
+    return scale == BandScale::Log ? view<FftSize, Rate, Bands, BandScale::Log>()
+                                   : view<FftSize, Rate, Bands, BandScale::Mel>();
+}
+
+template <size_t FftSize, unsigned Rate>
+inline View find(size_t bands, BandScale scale) {
+    switch (bands) {
+    case 24: return view<FftSize, Rate, 24>(scale); // 48 mirrored
+    case 32: return view<FftSize, Rate, 32>(scale);
+    case 48: return view<FftSize, Rate, 48>(scale);
+    case 64: return view<FftSize, Rate, 64>(scale);
+    default: return {nullptr, nullptr};
+    }
+}
+
+template <size_t FftSize>
+inline View find(unsigned rate, size_t bands, BandScale scale) {
+    switch (rate) {
+    case 44100: return find<FftSize, 44100>(bands, scale);
+    case 48000: return find<FftSize, 48000>(bands, scale);
+    default: return {nullptr, nullptr};
+    }
+}
+
+inline View find(size_t fft_size, unsigned rate, size_t bands, BandScale scale) {
+    switch (fft_size) {
+    case 1024: return find<1024>(rate, bands, scale);
+    case 2048: return find<2048>(rate, bands, scale);
+    default: return {nullptr, nullptr};
+    }
+}
+
+} // namespace band_map
+
+class BandMapper {
+public:
+    BandMapper(size_t fft_size, unsigned rate, size_t bands, BandScale scale)
+        : bands(bands) {
+        band_map::View v = band_map::find(fft_size, rate, bands, scale);
+        if (!v.edges) {
+            own_edges.resize(bands + 1);
+            own_bin_band.resize(fft_size / 2 + 1);
+            band_map::fill_edges(own_edges.data(), fft_size, rate, bands, scale);
+            band_map::fill_bin_band(own_bin_band.data(), own_edges.data(), fft_size, bands);
+            v = {own_edges.data(), own_bin_band.data()};
+        }
+        edges = v.edges;
+        bin_band = v.bin_band;
+        first = edges[0];
+        last = edges[bands];
+    }
+
+    BandMapper(const BandMapper&) = delete;
+    BandMapper& operator=(const BandMapper&) = delete;
+
+    size_t get_bands() const { return bands; }
+    bool is_precomputed() const { return own_edges.empty(); }
+    const uint16_t* get_edges() const { return edges; }
+
+    // Writes the peak bin magnitude of each bar into out[0..bands).
+    void map(const float* mags, float* out) const {
+        std::fill(out, out + bands, 0.0f);
+        for (size_t b = first; b < last; ++b) {
+            uint16_t i = bin_band[b];
+            out[i] = std::max(out[i], mags[b]);
+        }
+    }
+
+private:
+    size_t bands;
+    size_t first = 0, last = 0;
+    const uint16_t* edges = nullptr;
+    const uint16_t* bin_band = nullptr;
+    std::vector<uint16_t> own_edges, own_bin_band;
+};
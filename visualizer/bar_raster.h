@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kernels.h"
+#include "palette.h"
+
+// Software rasterizer for the bars. Cairo builds, clips and fills a path for
+// every rectangle; bars are axis-aligned spans of one color, so writing the
+// pixels directly is a handful of row fills. Pixels are CAIRO_FORMAT_ARGB32
+// (see palette.h), so the buffer can be a cairo_image_surface's data and
+// composited in one paint.
+namespace raster {
+
+// Span fills: n pixels of one value.
+using Fill = void (*)(uint32_t* dst, size_t n, uint32_t value);
+
+inline void fill_scalar(uint32_t* dst, size_t n, uint32_t value) {
+    for (size_t i = 0; i < n; ++i) dst[i] = value;
+}
+
+#ifdef VISUALIZER_X86
+
+__attribute__((target("sse2")))
+inline void fill_sse2(uint32_t* dst, size_t n, uint32_t value) {
+    __m128i v = _mm_set1_epi32((int)value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    fill_scalar(dst + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+inline void fill_avx2(uint32_t* dst, size_t n, uint32_t value) {
+    __m256i v = _mm256_set1_epi32((int)value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    fill_sse2(dst + i, n - i, value);
+}
+
+#endif // VISUALIZER_X86
+
+// The widest fill this CPU runs, resolved once.
+inline Fill best_fill() {
+    static const Fill fill = [] {
+#ifdef VISUALIZER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return fill_avx2;
+        if (__builtin_cpu_supports("sse2")) return fill_sse2;
+#endif
+        return fill_scalar;
+    }();
+    return fill;
+}
+
+} // namespace raster
+
+// Retained bars in a pixel buffer. layout() precomputes every bar's column
+// (structure of arrays, device pixels) whenever the allocation changes; after
+// that set() compares a bar against what the buffer already holds and
+// rewrites only the rows that differ, so a frame where few bars moved touches
+// few pixels. The buffer must start out transparent.
+class BarRaster {
+public:
+    static constexpr int kHighlightPx = 3;
+
+    explicit BarRaster(const Palette& palette) : palette(palette), fill(raster::best_fill()) {}
+
+    // Logical geometry as the widget lays it out, scaled to device pixels.
+    // Forgets what was drawn: pair it with a fresh, transparent buffer.
+    void layout(int bar_count, int left, int bar_width, int span, int width, int height, int scale) {
+        this->scale = scale;
+        this->height = height * scale;
+        x0.resize(bar_count);
+        spans.resize(bar_count);
+        for (int i = 0; i < bar_count; ++i) {
+            x0[i] = std::clamp((left + i * bar_width) * scale, 0, width * scale);
+            spans[i] = std::clamp(span * scale, 0, width * scale - x0[i]);
+        }
+        drawn_top.assign(bar_count, this->height);
+        drawn_color.assign(bar_count, 0);
+    }
+
+    // Brings bar i to top (logical pixels from the top edge) and palette
+    // color in pixels (stride in bytes). Returns whether anything was written.
+    bool set(uint8_t* pixels, int stride, int i, int top, uint8_t color) {
+        top = std::clamp(top * scale, 0, height);
+        int old = drawn_top[i];
+        if (top == old && color == drawn_color[i]) return false;
+
+        // Rows between the two tops change, plus the highlight under each;
+        // a new color repaints the bar down to the bottom.
+        int hl = kHighlightPx * scale;
+        int y0 = std::min(top, old);
+        int y1 = color != drawn_color[i] ? height : std::min(height, std::max(top, old) + hl);
+        int lit_end = std::min(height, top + hl);
+        for (int y = y0; y < y1; ++y) {
+            uint32_t value = y < top ? 0 : y < lit_end ? palette.lit(color) : palette.fill(color);
+            fill(reinterpret_cast<uint32_t*>(pixels + (size_t)y * stride) + x0[i], spans[i], value);
+        }
+        drawn_top[i] = top;
+        drawn_color[i] = color;
+        return true;
+    }
+
+private:
+    Palette palette;
+    raster::Fill fill;
+    int scale = 1, height = 0;
+    std::vector<int> x0;             // left edge of each bar
+    std::vector<int> spans;          // its width
+    std::vector<int> drawn_top;      // top edge the buffer holds, height = empty
+    std::vector<uint8_t> drawn_color;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "sample_ring.h"
+#include "spectrum.h"
+
+// Real-time onset and beat tracking on the captured audio.
+//
+// Every hop (~11.6 ms) the detector takes the spectral flux of a short mono
+// FFT: the rise in log-compressed magnitude, averaged over the bins. A hop is an onset
+// when its flux is a local peak above an adaptive threshold (a multiple of
+// the recent mean plus a floor, so silence and steady noise stay quiet).
+// Tempo comes from the autocorrelation of the onset envelope over the last
+// few seconds, weighted towards 120 BPM to settle octave ambiguity. Beats are
+// onsets that land near where the tempo says the next beat should be; when
+// none does the beat is filled in on time, for as long as onsets keep coming.
+//
+// All state is allocated up front. The autocorrelation is spread over the
+// hops a few lags at a time, so every hop costs one transform plus a fixed
+// amount of arithmetic, however long the history.
+class BeatDetector {
+public:
+    struct Stats {
+        uint64_t hops;
+        uint64_t onsets;
+        uint64_t beats;
+        double avg_us; // per hop, transform included
+        double max_us;
+    };
+
+    BeatDetector(unsigned rate, unsigned channels)
+        : size(rate >= 32000 ? 1024 : 512), hop(size / 2),
+          hop_rate((double)rate / hop), channels(channels),
+          spectrum(size, hop, channels, rate),
+          bins(size / 2 + 1),
+          min_lag((size_t)std::floor(hop_rate * 60.0 / kMaxBpm)),
+          max_lag((size_t)std::ceil(hop_rate * 60.0 / kMinBpm)),
+          history((size_t)(hop_rate * kHistorySeconds)) {
+        prev.assign(bins, 0.0f);
+        flux.assign(kThresholdHops, 0.0f);
+        env.assign(2 * history, 0.0f);
+        acf.assign(max_lag + 1, 0.0f);
+        min_gap = (size_t)(hop_rate * kMinOnsetGap);
+        lag_cursor = min_lag;
+    }
+
+    BeatDetector(const BeatDetector&) = delete;
+    BeatDetector& operator=(const BeatDetector&) = delete;
+
+    // Consumes interleaved frames; runs the detector once per completed hop.
+    void feed(const float* frames, size_t count) {
+        while (count > 0) {
+            size_t take = std::min(count, spectrum.frames_to_hop());
+            if (spectrum.feed(frames, take) > 0) step();
+            frames += take * channels;
+            count -= take;
+        }
+    }
+
+    // Beats and onsets seen so far; the UI compares against its last value.
+    uint64_t get_beats() const { return stats.beats; }
+    uint64_t get_onsets() const { return stats.onsets; }
+    // Current tempo estimate, 0 until there is one.
+    double get_bpm() const { return period > 0.0 ? 60.0 * hop_rate / period : 0.0; }
+
+    Stats get_stats() const { return stats; }
+
+private:
+    static constexpr double kMinBpm = 60.0;
+    static constexpr double kMaxBpm = 180.0;
+    static constexpr double kPreferredBpm = 120.0;
+    static constexpr double kHistorySeconds = 6.0;  // onset envelope kept for tempo
+    static constexpr double kMinOnsetGap = 0.1;     // seconds between onsets
+    static constexpr double kIdleSeconds = 2.0;     // stop filling in beats after this without onsets
+    static constexpr size_t kThresholdHops = 16;    // ~185 ms of flux for the threshold
+    static constexpr size_t kLagsPerHop = 4;
+    static constexpr float kCompression = 1000.0f;  // log1p(k * magnitude)
+    static constexpr float kThresholdScale = 1.5f;
+    static constexpr float kThresholdFloor = 0.05f;
+    static constexpr double kBeatTolerance = 0.2;   // of a period, either side
+
+    size_t size, hop;
+    double hop_rate;
+    unsigned channels;
+    SpectrumAnalyzer spectrum;
+    size_t bins;
+    size_t min_lag, max_lag, history;
+    size_t min_gap;
+
+    std::vector<float> prev;  // log magnitudes of the previous hop
+    std::vector<float> flux;  // recent flux, ring of kThresholdHops
+    std::vector<float> env;   // onset envelope, ring of `history` stored twice over
+                              // so every lag reads it contiguously
+    std::vector<float> acf;   // autocorrelation by lag, filled round-robin
+    float flux_sum = 0.0f;
+    float last_flux = 0.0f, last_delta = 0.0f;
+    uint64_t hop_index = 0;
+    uint64_t last_onset = 0, last_beat = 0;
+    bool any_onset = false;
+    double period = 0.0; // beat period in hops, 0 = no tempo yet
+    size_t lag_cursor;
+    Stats stats = {0, 0, 0, 0.0, 0.0};
+
+    void step() {
+        int64_t start = steady_now_ns();
+        const float* mags = spectrum.magnitudes();
+
+        // Half-wave rectified rise in log magnitude, averaged over bins so the
+        // scale does not depend on the FFT size.
+        float sum = 0.0f;
+        for (size_t b = 0; b < bins; ++b) {
+            float m = std::log1p(kCompression * mags[b]);
+            sum += std::max(0.0f, m - prev[b]);
+            prev[b] = m;
+        }
+        float f = sum / bins;
+
+        // Peak-pick the previous hop: its flux rose, then fell on this one,
+        // and it stands clear of the recent mean.
+        float mean = flux_sum / kThresholdHops;
+        float candidate = last_flux;
+        bool onset = candidate > f && last_delta > 0.0f
+                  && candidate > mean * kThresholdScale + kThresholdFloor
+                  && (!any_onset || hop_index - 1 - last_onset >= min_gap);
+
+        float& slot = flux[hop_index % kThresholdHops];
+        flux_sum += f - slot;
+        slot = f;
+        last_delta = f - last_flux;
+        last_flux = f;
+        size_t w = hop_index % history;
+        env[w] = env[w + history] = std::max(0.0f, f - mean);
+
+        if (onset) on_onset(hop_index - 1);
+        fill_in_beat();
+        update_tempo();
+
+        ++hop_index;
+        double us = (steady_now_ns() - start) / 1000.0;
+        stats.avg_us = stats.hops ? stats.avg_us * 0.95 + us * 0.05 : us;
+        stats.max_us = std::max(stats.max_us, us);
+        ++stats.hops;
+    }
+
+    void on_onset(uint64_t at) {
+        ++stats.onsets;
+        any_onset = true;
+        last_onset = at;
+        if (period == 0.0) {
+            beat(at); // no tempo yet: every onset counts
+            return;
+        }
+        double since = (double)(at - last_beat);
+        if (since >= period * (1.0 - kBeatTolerance)) beat(at);
+    }
+
+    // Keeps the beat going through onsets the detector missed.
+    void fill_in_beat() {
+        if (period == 0.0 || !any_onset) return;
+        if (hop_index - last_onset > hop_rate * kIdleSeconds) return;
+        double next = (double)last_beat + period;
+        if ((double)hop_index >= next + period * kBeatTolerance) beat((uint64_t)(next + 0.5));
+    }
+
+    void beat(uint64_t at) {
+        last_beat = at;
+        ++stats.beats;
+    }
+
+    // Advances the autocorrelation by kLagsPerHop lags; after a full sweep
+    // the best lag becomes the tempo.
+    void update_tempo() {
+        const float* newest = &env[hop_index % history + history];
+        for (size_t k = 0; k < kLagsPerHop; ++k) {
+            size_t lag = lag_cursor;
+            const float* a = newest - (history - 1 - lag);
+            const float* b = a - lag;
+            float s = 0.0f;
+            for (size_t j = 0; j < history - lag; ++j) s += a[j] * b[j];
+            acf[lag] = s;
+            if (++lag_cursor > max_lag) {
+                lag_cursor = min_lag;
+                pick_tempo();
+            }
+        }
+    }
+
+    void pick_tempo() {
+        size_t best = 0;
+        float best_score = 0.0f;
+        for (size_t lag = min_lag; lag <= max_lag; ++lag) {
+            double octaves = std::log2(60.0 * hop_rate / lag / kPreferredBpm);
+            float score = acf[lag] * (float)std::exp(-0.5 * octaves * octaves);
+            if (score > best_score) {
+                best_score = score;
+                best = lag;
+            }
+        }
+        if (best == 0) return;
+        // Parabolic interpolation between neighbouring lags.
+        double refined = best;
+        if (best > min_lag && best < max_lag) {
+            double a = acf[best - 1], b = acf[best], c = acf[best + 1];
+            double d = a - 2.0 * b + c;
+            if (d < 0.0) refined += 0.5 * (a - c) / d;
+        }
+        period = refined;
+    }
+};
@@ -0,0 +1,577 @@
+// Headless microbenchmarks for the visualizer pipeline. Needs no audio server
+// or display: run ./visualizer-bench [section ...] [--key=value ...], no
+// sections runs all. Built with -DHAVE_CAIRO the raster section also times
+// the old Cairo bar path. Settings are the visualizer's own (bars, scale,
+// capture, source, replay), so "pipeline --source=song.wav" benches a real
+// song and "replay --replay=session.cap" a captured session.
+
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_CAIRO
+#include <cairo.h>
+#endif
+
+#include "analysis.h"
+#include "bar_raster.h"
+#include "beat.h"
+#include "config.h"
+#include "kernels.h"
+#include "loudness.h"
+#include "radial.h"
+#include "recording.h"
+#include "scope.h"
+#include "signal_capture.h"
+#include "signal_source.h"
+#include "spectrum.h"
+#include "waterfall.h"
+
+namespace {
+
+// Runs fn until ~min_ms has passed and returns the mean ns per call.
+double time_ns(const std::function<void()>& fn, double min_ms = 100.0) {
+    using clock = std::chrono::steady_clock;
+    size_t iters = 1;
+    for (;;) {
+        auto start = clock::now();
+        for (size_t i = 0; i < iters; ++i) fn();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        if (ns >= min_ms * 1e6) return ns / iters;
+        iters *= 2;
+    }
+}
+
+std::vector<float> test_signal(size_t samples) {
+    std::vector<float> s(samples);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < samples; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        float noise = (float)(seed >> 8) / (1u << 24) - 0.5f;
+        s[i] = 0.6f * std::sin(i * 0.031f) + 0.2f * noise;
+    }
+    return s;
+}
+
+volatile float sink;
+
+void bench_kernels() {
+    std::vector<const kernels::Set*> sets = {&kernels::scalar()};
+#ifdef VISUALIZER_X86
+    if (__builtin_cpu_supports("sse2")) sets.push_back(&kernels::sse2());
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) sets.push_back(&kernels::avx2());
+#endif
+    std::printf("kernels (stereo float fragments, dispatch picks %s)\n", kernels::best().name);
+    std::printf("  %-8s %-14s %8s %10s %12s\n", "set", "kernel", "frames", "ns/frag", "Msamples/s");
+
+    for (size_t frames : {64, 256, 512, 1024, 4096}) {
+        std::vector<float> buf = test_signal(frames * 2);
+        float ref_peak = kernels::scalar().abs_peak(buf.data(), buf.size());
+        float ref_rms = kernels::scalar().rms(buf.data(), buf.size());
+        for (const kernels::Set* set : sets) {
+            float peaks[2], lo, hi, ref_lo, ref_hi;
+            set->channel_peaks(buf.data(), frames, 2, peaks);
+            set->min_max(buf.data(), buf.size(), &lo, &hi);
+            kernels::scalar().min_max(buf.data(), buf.size(), &ref_lo, &ref_hi);
+            if (set->abs_peak(buf.data(), buf.size()) != ref_peak || lo != ref_lo || hi != ref_hi ||
+                std::abs(set->rms(buf.data(), buf.size()) - ref_rms) > 1e-5f * ref_rms ||
+                std::max(peaks[0], peaks[1]) != ref_peak) {
+                std::printf("  %-8s MISMATCH against scalar at %zu frames\n", set->name, frames);
+            }
+
+            struct { const char* name; std::function<void()> fn; } cases[] = {
+                {"abs_peak", [&] { sink = set->abs_peak(buf.data(), buf.size()); }},
+                {"rms", [&] { sink = set->rms(buf.data(), buf.size()); }},
+                {"channel_peaks", [&] { set->channel_peaks(buf.data(), frames, 2, peaks); sink = peaks[0]; }},
+                {"min_max", [&] { set->min_max(buf.data(), buf.size(), &lo, &hi); sink = lo; }},
+            };
+            for (auto& c : cases) {
+                double ns = time_ns(c.fn, 50.0);
+                std::printf("  %-8s %-14s %8zu %10.1f %12.1f\n",
+                            set->name, c.name, frames, ns, buf.size() / ns * 1e3);
+            }
+        }
+    }
+}
+
+void bench_spectrum() {
+    std::printf("spectrum (stereo in, one hop fed and read, hop = size / 4)\n");
+    std::printf("  %8s %12s %12s\n", "size", "mono_us", "split_us");
+    for (size_t size : {1024, 2048, 4096}) {
+        std::vector<float> buf = test_signal(size / 4 * 2);
+        double us[2];
+        for (int split = 0; split < 2; ++split) {
+            SpectrumAnalyzer spectrum(size, size / 4, 2, 44100, SpectrumAnalyzer::Window::Hann, split);
+            us[split] = time_ns([&] {
+                spectrum.feed(buf.data(), size / 4);
+                for (unsigned o = 0; o < spectrum.get_outputs(); ++o) sink = spectrum.magnitudes(o)[1];
+            }) / 1e3;
+        }
+        std::printf("  %8zu %12.2f %12.2f\n", size, us[0], us[1]);
+    }
+}
+
+VisualizerConfig config;
+
+// Drives the widget's Analyzer the way the GTK tick does: a tick's worth of
+// audio lands in the ring, then one update. Timing covers the analysis only.
+void bench_pipeline() {
+    constexpr double kTickSeconds = 0.067;
+    constexpr double kAudioSeconds = 60.0;
+    std::printf("pipeline (%d bars, %g s of audio in %g ms ticks)\n",
+                config.bars, kAudioSeconds, kTickSeconds * 1e3);
+    std::printf("  %-12s %8s %8s %10s %10s %10s %12s\n",
+                "source", "rate", "channels", "us/update", "max_us", "ns/frame", "x realtime");
+
+    std::vector<std::string> specs(std::begin(SignalSource::kGenerators), std::end(SignalSource::kGenerators));
+    if (!config.source.empty()) specs = {config.source};
+    for (const std::string& spec : specs) {
+        std::unique_ptr<SignalSource> source = SignalSource::open(spec, config.capture);
+        if (!source) continue;
+        const unsigned rate = source->get_rate(), channels = source->get_channels();
+        const size_t tick = (size_t)(rate * kTickSeconds);
+        const bool peaks = config.capture == CaptureProfile::Peaks;
+        const size_t block = rate / 100 * channels; // peak-detect block, as the backends fold it
+
+        SampleRing ring(peaks ? 1 : channels, peaks ? 100 : rate, rate);
+        Analyzer analyzer(config, config.capture, peaks ? 100 : rate, peaks ? 1 : channels);
+        std::vector<float> buf(tick * channels);
+        std::vector<float> levels;
+        size_t ticks = (size_t)(kAudioSeconds / kTickSeconds);
+        double total_ns = 0.0;
+        for (size_t t = 0; t < ticks; ++t) {
+            source->read(buf.data(), tick);
+            if (peaks) {
+                levels.clear();
+                for (size_t i = 0; i + block <= buf.size(); i += block) {
+                    levels.push_back(kernels::best().abs_peak(buf.data() + i, block));
+                }
+                ring.push(levels.data(), levels.size(), 0);
+            } else {
+                ring.push(buf.data(), tick, 0);
+            }
+            auto start = std::chrono::steady_clock::now();
+            analyzer.update(ring);
+            total_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            sink = analyzer.levels()[0];
+        }
+        std::string name = spec.size() > 12 ? "..." + spec.substr(spec.size() - 9) : spec;
+        std::printf("  %-12s %8u %8u %10.2f %10.2f %10.2f %12.0f\n",
+                    name.c_str(), rate, channels, total_ns / ticks / 1e3, analyzer.get_stats().max_us,
+                    total_ns / (ticks * tick), kAudioSeconds * 1e9 / total_ns);
+    }
+}
+
+// Feeds a capture recording through the Analyzer on the recorded clock: every
+// fragment enters the ring at its arrival time and the analysis ticks every
+// 67 ms of recorded time, so the fragment pattern is the real one and the
+// output is deterministic. The checksum covers every update's levels, so two
+// builds that print the same one produced byte-identical bars.
+void bench_replay() {
+    constexpr int64_t kTickNs = 67000000;
+    if (config.replay.empty()) {
+        std::printf("replay (skipped, needs --replay=file)\n");
+        return;
+    }
+    std::unique_ptr<Recording> recording = Recording::open(config.replay);
+    if (!recording) return;
+    const unsigned rate = recording->get_rate(), channels = recording->get_channels();
+    SampleRing ring(channels, rate, rate);
+    Analyzer analyzer(config, recording->get_profile(), rate, channels);
+
+    uint64_t checksum = 1469598103934665603ull; // FNV-1a
+    auto tick = [&] {
+        analyzer.update(ring);
+        const std::vector<float>& levels = analyzer.levels();
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(levels.data());
+        for (size_t i = 0; i < levels.size() * sizeof(float); ++i) checksum = (checksum ^ p[i]) * 1099511628211ull;
+    };
+
+    size_t fragments = 0, min_frames = SIZE_MAX, max_frames = 0;
+    int64_t next_tick = kTickNs, last_offset = 0, max_gap = 0;
+    Recording::Fragment f;
+    for (size_t pos = Recording::begin(); recording->next(pos, f);) {
+        for (; next_tick <= f.offset_ns; next_tick += kTickNs) tick();
+        if (fragments > 0) max_gap = std::max(max_gap, f.offset_ns - last_offset);
+        if (f.format == recording::S16) {
+            ring.push(static_cast<const int16_t*>(f.samples), f.frames, f.offset_ns);
+        } else {
+            ring.push(static_cast<const float*>(f.samples), f.frames, f.offset_ns);
+        }
+        last_offset = f.offset_ns;
+        min_frames = std::min<size_t>(min_frames, f.frames);
+        max_frames = std::max<size_t>(max_frames, f.frames);
+        ++fragments;
+    }
+    tick();
+
+    Analyzer::Stats a = analyzer.get_stats();
+    std::printf("replay (%s, %u Hz, %u channels, %d bars)\n", config.replay.c_str(), rate, channels, config.bars);
+    if (fragments == 0) {
+        std::printf("  no fragments\n");
+        return;
+    }
+    std::printf("  %zu fragments over %.2f s, %zu-%zu frames, longest gap %.1f ms, ring overruns %llu\n",
+                fragments, last_offset / 1e9, min_frames, max_frames, max_gap / 1e6,
+                (unsigned long long)ring.get_stats().overruns);
+    std::printf("  %llu updates, avg %.2f us, max %.2f us, checksum %016llx\n",
+                (unsigned long long)a.updates, a.avg_us, a.max_us, (unsigned long long)checksum);
+}
+
+// K-weighting filter cost per 20 ms fragment, scalar against the SSE2 stereo
+// path, plus a calibration check: EBU Tech 3341 expects a 997 Hz stereo sine
+// at -23 dBFS to read -23.0 LUFS.
+void bench_loudness() {
+    std::printf("loudness (20 ms fragments)\n");
+    std::printf("  %6s %8s %8s %12s %14s\n", "rate", "channels", "path", "ns/fragment", "sine -23 dBFS");
+    for (unsigned rate : {44100u, 48000u}) {
+        for (unsigned channels : {1u, 2u}) {
+            const size_t frames = rate / 50;
+            std::vector<float> sine(rate * 3 * channels);
+            const double amp = std::pow(10.0, -23.0 / 20.0);
+            for (size_t i = 0; i < sine.size() / channels; ++i) {
+                for (unsigned c = 0; c < channels; ++c) {
+                    sine[i * channels + c] = (float)(amp * std::sin(2.0 * M_PI * 997.0 * i / rate));
+                }
+            }
+            LoudnessMeter meter(rate, channels);
+            meter.feed(sine.data(), sine.size() / channels);
+            double lufs = meter.short_term();
+            size_t pos = 0;
+            double ns = time_ns([&] {
+                meter.feed(sine.data() + pos * channels, frames);
+                pos = (pos + frames) % (sine.size() / channels - frames);
+            });
+            std::printf("  %6u %8u %8s %12.0f %9.2f LUFS\n", rate, channels, meter.is_simd() ? "sse2" : "scalar",
+                        ns, lufs);
+        }
+    }
+}
+
+// Runs the beat detector alone over test signals, a --source file or a
+// --replay recording, fed in the fragments they arrive in.
+void bench_beats() {
+    std::printf("beats (detector only)\n");
+    std::printf("  %-12s %8s %8s %10s %10s %8s %8s %8s\n",
+                "source", "seconds", "hops", "us/hop", "max_us", "onsets", "beats", "bpm");
+    auto report = [](const std::string& spec, double seconds, const BeatDetector& d) {
+        BeatDetector::Stats st = d.get_stats();
+        std::string name = spec.size() > 12 ? "..." + spec.substr(spec.size() - 9) : spec;
+        std::printf("  %-12s %8.1f %8llu %10.2f %10.2f %8llu %8llu %8.1f\n", name.c_str(), seconds,
+                    (unsigned long long)st.hops, st.avg_us, st.max_us, (unsigned long long)st.onsets,
+                    (unsigned long long)st.beats, d.get_bpm());
+    };
+
+    if (!config.replay.empty()) {
+        std::unique_ptr<Recording> recording = Recording::open(config.replay);
+        if (!recording || recording->get_profile() == CaptureProfile::Peaks) return;
+        const unsigned rate = recording->get_rate(), channels = recording->get_channels();
+        SampleRing ring(channels, rate, rate);
+        BeatDetector detector(rate, channels);
+        std::vector<float> buf(rate * channels);
+        Recording::Fragment f;
+        int64_t end = 0;
+        for (size_t pos = Recording::begin(); recording->next(pos, f);) {
+            if (f.format == recording::S16) {
+                ring.push(static_cast<const int16_t*>(f.samples), f.frames, f.offset_ns);
+            } else {
+                ring.push(static_cast<const float*>(f.samples), f.frames, f.offset_ns);
+            }
+            detector.feed(buf.data(), ring.read(buf.data(), rate));
+            end = f.offset_ns;
+        }
+        report(config.replay, end / 1e9, detector);
+        return;
+    }
+
+    constexpr double kSeconds = 60.0;
+    CaptureProfile profile = config.capture == CaptureProfile::Peaks ? CaptureProfile::Full : config.capture;
+    std::vector<std::string> specs(std::begin(SignalSource::kGenerators), std::end(SignalSource::kGenerators));
+    if (!config.source.empty()) specs = {config.source};
+    for (const std::string& spec : specs) {
+        std::unique_ptr<SignalSource> source = SignalSource::open(spec, profile);
+        if (!source) continue;
+        const size_t fragment = source->get_rate() / 50; // ~20 ms, like the live backends
+        BeatDetector detector(source->get_rate(), source->get_channels());
+        std::vector<float> buf(fragment * source->get_channels());
+        for (size_t done = 0; done < kSeconds * source->get_rate(); done += fragment) {
+            source->read(buf.data(), fragment);
+            detector.feed(buf.data(), fragment);
+        }
+        report(spec, kSeconds, detector);
+    }
+}
+
+// Power-saving round trip on a paced impulse source (one click a second):
+// Paused must deliver nothing, Watching must wake on the first click and
+// hand that fragment to the ring.
+void bench_idle() {
+    std::printf("idle (impulse, paced)\n");
+    std::unique_ptr<SignalCapture> capture = SignalCapture::create("impulse", config.capture, true);
+    if (!capture) return;
+    SampleRing& ring = capture->samples();
+    pollfd pfd = {capture->get_wake_fd(), POLLIN, 0};
+
+    capture->set_activity(CaptureBackend::Activity::Paused);
+    ring.skip(ring.available());
+    uint64_t before = capture->get_stats().fragments;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    std::printf("  paused 1.5 s: %llu fragments, %zu frames in ring, woke %s\n",
+                (unsigned long long)(capture->get_stats().fragments - before), ring.available(),
+                poll(&pfd, 1, 0) > 0 ? "yes" : "no");
+
+    capture->set_activity(CaptureBackend::Activity::Watching);
+    int64_t start = steady_now_ns();
+    int ready = poll(&pfd, 1, 2000);
+    int64_t woke = steady_now_ns();
+    uint64_t n = 0;
+    if (ready > 0 && read(pfd.fd, &n, sizeof(n)) < 0) n = 0;
+    int64_t sound = capture->last_sound_ns();
+    std::printf("  watching: woke %s after %.1f ms, %.3f ms after the click arrived, %zu frames in ring,"
+                " activity %s, wakeups %llu\n",
+                n ? "yes" : "no", (woke - start) / 1e6, (woke - sound) / 1e6, ring.available(),
+                capture->get_activity() == CaptureBackend::Activity::Capturing ? "capturing" : "still idle",
+                (unsigned long long)capture->get_stats().wakeups);
+}
+
+// Bar drawing at common panel widths (200 px tall, --bars bars, the light
+// theme's gradient): the retained rasterizer updating only what moved, the
+// same rasterizer redrawing from a cleared buffer, and, with Cairo, the old
+// path of a clear plus two rectangle fills per bar. Bars follow a smoothed
+// random walk, like music; the Cairo and raster pixels are compared too.
+void bench_raster() {
+    constexpr int kHeight = 200;
+    constexpr int kFrames = 64;
+    const int bars = config.bars;
+    const Palette palette({{0.0f, {1.0, 0.75, 0.8, 0.9}}, {0.45f, {1.0, 0.4, 0.7, 0.9}}, {1.0f, {1.0, 0.2, 0.6, 0.9}}});
+
+    // Shapes per frame, as the widget computes them.
+    std::vector<int> tops(kFrames * bars);
+    std::vector<uint8_t> bands(kFrames * bars);
+    uint32_t seed = 12345;
+    std::vector<float> level(bars, 0.3f);
+    for (int f = 0; f < kFrames; ++f) {
+        for (int i = 0; i < bars; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            float target = (float)(seed >> 8) / (1u << 24);
+            level[i] = level[i] * 0.65f + target * 0.35f;
+            float h = std::max(2.0f, level[i] * kHeight);
+            tops[f * bars + i] = (int)(kHeight - h);
+            bands[f * bars + i] = Palette::index(h / kHeight);
+        }
+    }
+
+    std::printf("raster (%d bars, %d px tall, fill %s)\n", bars, kHeight,
+                raster::best_fill() == raster::fill_scalar ? "scalar" : "simd");
+    std::printf("  %6s %12s %12s %12s %10s\n", "width", "cairo_us", "full_us", "retained_us", "max_diff");
+    for (int width : {1920, 2560, 3840}) {
+        int bar_width = width / bars;
+        int gap = std::min(12, bar_width / 3);
+        int stride = width * 4;
+        std::vector<uint8_t> pixels(stride * kHeight);
+        BarRaster bar_raster(palette);
+        auto draw = [&](int f) {
+            for (int i = 0; i < bars; ++i) {
+                bar_raster.set(pixels.data(), stride, i, tops[f * bars + i], bands[f * bars + i]);
+            }
+        };
+
+        int frame = 0;
+        bar_raster.layout(bars, 0, bar_width, bar_width - gap, width, kHeight, 1);
+        double retained = time_ns([&] { draw(frame++ % kFrames); }) / 1e3;
+        double full = time_ns([&] {
+            std::fill(pixels.begin(), pixels.end(), 0);
+            bar_raster.layout(bars, 0, bar_width, bar_width - gap, width, kHeight, 1);
+            draw(frame++ % kFrames);
+        }) / 1e3;
+
+        double cairo_us = 0.0;
+        int max_diff = -1;
+#ifdef HAVE_CAIRO
+        cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, kHeight);
+        cairo_t* cr = cairo_create(surface);
+        auto draw_cairo = [&](int f) {
+            cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+            cairo_set_source_rgba(cr, 0, 0, 0, 0);
+            cairo_paint(cr);
+            cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+            for (int i = 0; i < bars; ++i) {
+                int top = tops[f * bars + i], h = kHeight - top;
+                // The palette entry, unpremultiplied again for Cairo.
+                uint32_t c = palette.fill(bands[f * bars + i]);
+                double a = (c >> 24) / 255.0;
+                cairo_set_source_rgba(cr, (c >> 16 & 0xff) / 255.0 / a, (c >> 8 & 0xff) / 255.0 / a,
+                                      (c & 0xff) / 255.0 / a, a);
+                cairo_rectangle(cr, i * bar_width, top, bar_width - gap, h);
+                cairo_fill(cr);
+                cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.6);
+                cairo_rectangle(cr, i * bar_width, top, bar_width - gap, std::min(BarRaster::kHighlightPx, h));
+                cairo_fill(cr);
+            }
+        };
+        cairo_us = time_ns([&] { draw_cairo(frame++ % kFrames); }) / 1e3;
+
+        draw_cairo(kFrames - 1);
+        cairo_surface_flush(surface);
+        std::fill(pixels.begin(), pixels.end(), 0);
+        bar_raster.layout(bars, 0, bar_width, bar_width - gap, width, kHeight, 1);
+        draw(kFrames - 1);
+        const uint8_t* ref = cairo_image_surface_get_data(surface);
+        int ref_stride = cairo_image_surface_get_stride(surface);
+        max_diff = 0;
+        for (int y = 0; y < kHeight; ++y) {
+            for (int x = 0; x < stride; ++x) {
+                max_diff = std::max(max_diff, std::abs(ref[y * ref_stride + x] - pixels[y * stride + x]));
+            }
+        }
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+#endif
+        if (max_diff < 0) {
+            std::printf("  %6d %12s %12.2f %12.2f %10s\n", width, "-", full, retained, "-");
+        } else {
+            std::printf("  %6d %12.2f %12.2f %12.2f %10d\n", width, cairo_us, full, retained, max_diff);
+        }
+    }
+}
+
+// Cost of one waterfall row at common widths and history lengths. Only the
+// new row is written, so the history length must not show up in the time.
+void bench_waterfall() {
+    const int bars = config.bars;
+    const Palette palette({{0.0f, {1.0, 0.75, 0.8, 0.9}}, {1.0f, {1.0, 0.2, 0.6, 0.9}}});
+    std::vector<float> levels = test_signal(bars);
+    for (float& l : levels) l = std::abs(l);
+
+    std::printf("waterfall (%d bars, one row per update)\n", bars);
+    std::printf("  %6s %8s %10s\n", "width", "rows", "ns/row");
+    for (int width : {1920, 3840}) {
+        for (int rows : {200, 2000}) {
+            std::vector<uint8_t> pixels((size_t)width * 4 * rows);
+            Waterfall waterfall(palette);
+            waterfall.layout(bars, width, rows);
+            double ns = time_ns([&] { waterfall.push(pixels.data(), width * 4, levels.data()); });
+            std::printf("  %6d %8d %10.1f\n", width, rows, ns);
+        }
+    }
+}
+
+// Cost of one scope frame (trigger search, min/max decimation and the
+// column spans) up to a 4K-wide bottom bar, at the widget's default rate and
+// fps. The signal moves between frames so every frame redraws; "decimate"
+// redraws the same window, so no pixel changes and only the trigger search
+// and the min/max remain.
+void bench_scope() {
+    const int height = 200;
+    const size_t per_draw = 44100 / config.fps;
+    const Palette palette({{0.0f, {1.0, 0.75, 0.8, 0.9}}, {1.0f, {1.0, 0.2, 0.6, 0.9}}});
+    std::vector<float> signal = test_signal(Scope::kMaxHistory * 4);
+
+    std::printf("scope (%zu frames per draw, %d rows, min_max %s)\n", per_draw, height, kernels::best().name);
+    std::printf("  %6s %8s %10s %10s %12s %10s\n", "width", "window", "ns/frame", "ns/column", "decimate ns", "triggered");
+    for (int width : {640, 1920, 2560, 3840}) {
+        std::vector<uint8_t> pixels((size_t)width * 4 * height);
+        Scope scope(palette);
+        scope.layout(width, height, per_draw);
+        size_t offset = 0;
+        double ns = time_ns([&] {
+            offset = (offset + 797) % (signal.size() - scope.get_history());
+            scope.draw(pixels.data(), width * 4, signal.data() + offset);
+        });
+        double triggered = 100.0 * scope.get_triggered() / std::max<uint64_t>(1, scope.get_frames());
+        double decimate_ns = time_ns([&] { scope.draw(pixels.data(), width * 4, signal.data() + offset); });
+        std::printf("  %6d %8zu %10.1f %10.2f %12.1f %9.0f%%\n", width, scope.get_window(), ns, ns / width,
+                    decimate_ns, triggered);
+    }
+}
+
+// Per-frame geometry of the radial layout: quads off the layout tables
+// against the same quads with the trigonometry redone every frame.
+void bench_radial() {
+    const int width = 3840, height = 200;
+    std::printf("radial (%dx%d, quads per frame)\n", width, height);
+    std::printf("  %6s %12s %12s %10s\n", "bars", "table ns", "trig ns", "max_diff");
+    for (int bars : {48, 128, 512}) {
+        std::vector<float> levels = test_signal(bars);
+        for (float& l : levels) l = std::abs(l);
+        RadialLayout radial;
+        radial.layout(bars, width, height);
+
+        // The old way: angle, sin/cos and corners for every bar every frame.
+        const float cx = width * 0.5f, cy = height * 0.5f;
+        const float outer = std::min(width, height) * 0.5f - 2.0f;
+        const float inner = outer * RadialLayout::kInnerFraction;
+        const float hw = (float)M_PI * inner / bars * RadialLayout::kFill;
+        auto trig_quad = [&](int i, float level) {
+            double angle = -M_PI / 2 + 2 * M_PI * (i + 0.5) / bars;
+            float dx = (float)std::cos(angle), dy = (float)std::sin(angle);
+            float r0 = inner, r1 = inner + level * (outer - inner);
+            return RadialLayout::Quad{{cx + dx * r0 - dy * hw, cx + dx * r0 + dy * hw, cx + dx * r1 + dy * hw, cx + dx * r1 - dy * hw},
+                                      {cy + dy * r0 + dx * hw, cy + dy * r0 - dx * hw, cy + dy * r1 - dx * hw, cy + dy * r1 + dx * hw}};
+        };
+
+        float max_diff = 0.0f;
+        for (int i = 0; i < bars; ++i) {
+            RadialLayout::Quad a = radial.quad(i, levels[i]), b = trig_quad(i, levels[i]);
+            for (int k = 0; k < 4; ++k) {
+                max_diff = std::max({max_diff, std::abs(a.x[k] - b.x[k]), std::abs(a.y[k] - b.y[k])});
+            }
+        }
+        double table_ns = time_ns([&] {
+            float acc = 0.0f;
+            for (int i = 0; i < bars; ++i) acc += radial.quad(i, levels[i]).x[2];
+            sink = acc;
+        });
+        double trig_ns = time_ns([&] {
+            float acc = 0.0f;
+            for (int i = 0; i < bars; ++i) acc += trig_quad(i, levels[i]).x[2];
+            sink = acc;
+        });
+        std::printf("  %6d %12.1f %12.1f %10.4f\n", bars, table_ns, trig_ns, max_diff);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    struct { const char* name; void (*fn)(); } sections[] = {
+        {"kernels", bench_kernels},
+        {"spectrum", bench_spectrum},
+        {"pipeline", bench_pipeline},
+        {"replay", bench_replay},
+        {"beats", bench_beats},
+        {"loudness", bench_loudness},
+        {"idle", bench_idle},
+        {"raster", bench_raster},
+        {"radial", bench_radial},
+        {"waterfall", bench_waterfall},
+        {"scope", bench_scope},
+    };
+    // --key=value settings go to the config, anything else names a section.
+    std::vector<char*> settings = {argv[0]}, names;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--", 2) != 0) {
+            names.push_back(argv[i]);
+            continue;
+        }
+        settings.push_back(argv[i]);
+        if (!std::strchr(argv[i], '=') && i + 1 < argc) settings.push_back(argv[++i]);
+    }
+    config.parse_args((int)settings.size(), settings.data());
+
+    for (auto& s : sections) {
+        bool run = names.empty();
+        for (char* name : names) run |= std::strcmp(name, s.name) == 0;
+        if (run) s.fn();
+    }
+    return 0;
+}
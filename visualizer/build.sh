@@ -1,5 +1,27 @@
 #!/bin/bash
 
-g++ -std=c++17 visualizer-dark.cpp -o visualizer-dark     `pkg-config --cflags --libs gtkmm-3.0 gtk-layer-shell-0 libpulse`
+LIBS="gtkmm-3.0 gtk-layer-shell-0 libpulse"
+DEFS=""
 
-g++ -std=c++17 visualizer.cpp -o visualizer     `pkg-config --cflags --libs gtkmm-3.0 gtk-layer-shell-0 libpulse`
+# Native PipeWire capture is optional; without it the visualizer uses libpulse
+if pkg-config --exists libpipewire-0.3; then
+    LIBS="$LIBS libpipewire-0.3"
+    DEFS="-DHAVE_PIPEWIRE"
+fi
+
+g++ -std=c++17 -O2 $DEFS visualizer-dark.cpp -o visualizer-dark     `pkg-config --cflags --libs $LIBS`
+
+g++ -std=c++17 -O2 $DEFS visualizer.cpp -o visualizer     `pkg-config --cflags --libs $LIBS`
+
+# Headless microbenchmarks, no GTK or PulseAudio needed; with Cairo the
+# raster section also times the old Cairo bar path
+BENCH_DEFS=""
+BENCH_LIBS=""
+if pkg-config --exists cairo; then
+    BENCH_DEFS="-DHAVE_CAIRO"
+    BENCH_LIBS=`pkg-config --cflags --libs cairo`
+fi
+g++ -std=c++17 -O2 -pthread $BENCH_DEFS bench.cpp -o visualizer-bench $BENCH_LIBS
+
+# Config parsing checks, also GTK-free; the script exits with their status
+g++ -std=c++17 -O2 config_test.cpp -o visualizer-config-test && ./visualizer-config-test
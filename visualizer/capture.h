@@ -0,0 +1,188 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "config.h"
+#include "kernels.h"
+#include "recording.h"
+#include "sample_ring.h"
+
+// Base for every audio source the visualizer can draw from. A backend owns
+// its transport (PulseAudio, PipeWire, ...) and hands fragments to deliver()
+// from its own thread; the GTK thread only ever touches samples() and the
+// counters, so everything downstream of the ring is backend-agnostic.
+class CaptureBackend {
+public:
+    // Capture health counters, all cumulative since startup.
+    struct Stats {
+        uint64_t fragments;       // fragments pushed into the ring
+        uint64_t bytes;           // bytes of audio in those fragments
+        uint64_t holes;           // gaps reported by the server
+        uint64_t hole_bytes;      // audio lost to those gaps
+        uint64_t server_overruns; // server-side record buffer overflows
+        uint64_t read_errors;     // failed reads from the server
+        uint64_t reconnects;
+        uint64_t moves;
+        uint64_t wakeups;         // times sound ended Watching
+        SampleRing::Stats ring;   // client-side overruns/underruns
+    };
+
+    // Power saving, driven by the UI. Watching stops filling the ring and
+    // only listens for sound, as cheaply as the transport allows; the first
+    // fragment that isn't digital silence switches back to Capturing by
+    // itself (that fragment still reaches the ring) and signals the wake fd.
+    // Paused listens for nothing.
+    enum class Activity { Capturing, Watching, Paused };
+
+    CaptureBackend(CaptureProfile profile, unsigned channels, unsigned rate)
+        : profile(profile), rate(rate), ring(channels, rate, rate / 2),
+          wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), last_sound(steady_now_ns()) {}
+    virtual ~CaptureBackend() {
+        if (wake_fd >= 0) close(wake_fd);
+    }
+
+    CaptureBackend(const CaptureBackend&) = delete;
+    CaptureBackend& operator=(const CaptureBackend&) = delete;
+
+    virtual const char* get_name() const = 0;
+
+    bool is_connected() const { return connected; }
+    SampleRing& samples() { return ring; }
+    unsigned get_rate() const { return rate; }
+    CaptureProfile get_profile() const { return profile; }
+
+    // The backend's own estimate of how old a fragment is when it reaches
+    // deliver(): server/graph buffering plus device latency, in microseconds.
+    int64_t get_latency_us() const { return latency_us.load(std::memory_order_relaxed); }
+
+    Stats get_stats() const {
+        return {fragments.load(std::memory_order_relaxed),
+                bytes.load(std::memory_order_relaxed),
+                holes.load(std::memory_order_relaxed),
+                hole_bytes.load(std::memory_order_relaxed),
+                server_overruns.load(std::memory_order_relaxed),
+                read_errors.load(std::memory_order_relaxed),
+                reconnects.load(std::memory_order_relaxed),
+                moves.load(std::memory_order_relaxed),
+                wakeups.load(std::memory_order_relaxed),
+                ring.get_stats()};
+    }
+
+    // From the GTK thread.
+    void set_activity(Activity a) {
+        if (activity.exchange(a) != a) on_activity(a);
+    }
+    Activity get_activity() const { return activity.load(std::memory_order_acquire); }
+
+    // Readable (an eventfd) after sound ended Watching; the reader drains it.
+    int get_wake_fd() const { return wake_fd; }
+
+    // Arrival of the newest fragment that wasn't digital silence; startup
+    // counts as sound.
+    int64_t last_sound_ns() const { return last_sound.load(std::memory_order_relaxed); }
+
+    // Copies every fragment delivered from now on to a recording at path
+    // (see recording.h). Returns false if the file can't be created.
+    bool record_to(const std::string& path) {
+        recorder_owner = CaptureRecorder::create(path, profile, rate, ring.get_channels(), steady_now_ns());
+        recorder.store(recorder_owner.get(), std::memory_order_release);
+        return recorder_owner != nullptr;
+    }
+
+protected:
+    // Anything at or below one 16-bit step is digital silence.
+    static constexpr float kSilence = 1.0f / 32768;
+
+    CaptureProfile profile;
+    unsigned rate;
+    SampleRing ring;
+    std::atomic<bool> connected{false};
+    std::atomic<int64_t> latency_us{0};
+    std::atomic<uint64_t> fragments{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> holes{0};
+    std::atomic<uint64_t> hole_bytes{0};
+    std::atomic<uint64_t> server_overruns{0};
+    std::atomic<uint64_t> read_errors{0};
+    std::atomic<uint64_t> reconnects{0};
+    std::atomic<uint64_t> moves{0};
+    std::atomic<uint64_t> wakeups{0};
+
+    // Transport hook for activity changes, called on the GTK thread. The
+    // default leaves the transport running and lets deliver() do the
+    // watching and dropping.
+    virtual void on_activity(Activity) {}
+
+    // Watching -> Capturing because the transport heard sound. Returns false
+    // if the UI changed the activity first.
+    bool wake() {
+        Activity expected = Activity::Watching;
+        if (!activity.compare_exchange_strong(expected, Activity::Capturing)) return false;
+        last_sound.store(steady_now_ns(), std::memory_order_relaxed);
+        wakeups.fetch_add(1, std::memory_order_relaxed);
+        // Only fails if the counter is saturated, which still reads as woken.
+        uint64_t one = 1;
+        ssize_t r = write(wake_fd, &one, sizeof(one));
+        (void)r;
+        return true;
+    }
+
+    // Pushes one fragment that finished arriving just now.
+    template <typename Sample>
+    void deliver(const Sample* frames, size_t count) {
+        // The fragment ends "now", so its first frame is that much older.
+        int64_t now = steady_now_ns();
+        Activity a = activity.load(std::memory_order_acquire);
+        if (a == Activity::Paused) return;
+        bool sound = peak_of(frames, count * ring.get_channels()) > kSilence;
+        if (sound) last_sound.store(now, std::memory_order_relaxed);
+        if (a == Activity::Watching && !(sound && wake())) return;
+        ring.push(frames, count, now - (int64_t)(count * 1000000000ull / rate));
+        if (CaptureRecorder* r = recorder.load(std::memory_order_acquire)) r->write(frames, count, now);
+        fragments.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(count * ring.get_channels() * sizeof(Sample), std::memory_order_relaxed);
+    }
+
+    float peak_of(const float* samples, size_t n) const { return peak_kernels.abs_peak(samples, n); }
+    static float peak_of(const int16_t* samples, size_t n) {
+        int peak = 0;
+        for (size_t i = 0; i < n; ++i) peak = std::max(peak, std::abs((int)samples[i]));
+        return peak / 32768.0f;
+    }
+
+    // For sources with no server-side peak detection: reduces every block of
+    // block samples (all channels) to its peak and delivers one level each.
+    void deliver_peaks(const float* samples, size_t count, size_t block) {
+        while (count > 0) {
+            size_t take = std::min(count, block - peak_fill);
+            peak_acc = std::max(peak_acc, peak_kernels.abs_peak(samples, take));
+            samples += take;
+            count -= take;
+            peak_fill += take;
+            if (peak_fill == block) {
+                deliver(&peak_acc, 1);
+                peak_acc = 0.0f;
+                peak_fill = 0;
+            }
+        }
+    }
+
+private:
+    std::atomic<Activity> activity{Activity::Capturing};
+    int wake_fd;
+    std::atomic<int64_t> last_sound;
+    float peak_acc = 0.0f;
+    size_t peak_fill = 0;
+    const kernels::Set& peak_kernels = kernels::best();
+    // Set once from the GTK thread, then only used by the capture thread.
+    // Destroyed with the base, after the derived class stopped that thread.
+    std::unique_ptr<CaptureRecorder> recorder_owner;
+    std::atomic<CaptureRecorder*> recorder{nullptr};
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "band_map.h"
+#include "palette.h"
+
+// What the record stream asks the server for. Full is float stereo at
+// 44.1 kHz (~350 KB/s over the socket); Compact is S16 mono at 22.05 kHz
+// (~44 KB/s, same FFT resolution with a 1024-point transform); Peaks lets the
+// server's peak-detect resampler send ~100 levels a second (<1 KB/s) and
+// drops the spectrum in favour of a scrolling level meter.
+enum class CaptureProfile { Full, Compact, Peaks };
+
+// Levels a second in the Peaks profile, and the rate they are folded from
+// when the backend does the peak detection itself (PipeWire's graph rate,
+// generated and file sources).
+constexpr unsigned kPeakRate = 100;
+constexpr unsigned kPeakSourceRate = 48000;
+
+// Frame rate and channel count the capture ring carries for a profile.
+inline unsigned profile_rate(CaptureProfile profile) {
+    switch (profile) {
+    case CaptureProfile::Compact: return 22050;
+    case CaptureProfile::Peaks: return kPeakRate;
+    default: return 44100;
+    }
+}
+
+inline unsigned profile_channels(CaptureProfile profile) {
+    return profile == CaptureProfile::Full ? 2 : 1;
+}
+
+enum class CaptureBackendKind { Auto, Pulse, PipeWire };
+
+// How bars are laid out. Spectrum runs low to high across the window from a
+// mono mixdown; Mirror puts the left channel's spectrum on the left half and
+// the right channel's on the right, both starting from the center.
+enum class BarLayout { Spectrum, Mirror };
+
+// What the window shows of the analysis: bars, the same bars radiating
+// around the sprite, a scrolling spectrogram of them (one row per analysis
+// update), or an oscilloscope of the captured waveform.
+enum class ViewMode { Bars, Radial, Waterfall, Scope };
+
+// Cross-process sharing of the analysis (shared_spectrum.h). Publish captures
+// and analyzes as usual and shares the results; Subscribe draws whatever a
+// publisher shares and captures nothing, falling back to capturing itself
+// when no publisher is running at startup.
+enum class ShareMode { Off, Publish, Subscribe };
+
+// Runtime settings shared by both visualizer builds. Defaults come first,
+// then ~/.config/Elysia/widgets/visualizer/visualizer.conf (key = value, '#'
+// comments at the start of a line or after whitespace), then --key=value /
+// --key value on the command line.
+struct VisualizerConfig {
+    int bars = 48;
+    int fps = 15; // redraws per second, capped by the monitor's refresh rate
+    BandScale scale = BandScale::Log;
+    BarLayout layout = BarLayout::Spectrum;
+    ViewMode mode = ViewMode::Bars;
+    ShareMode share = ShareMode::Off;
+    bool auto_gain = true; // scale bars by measured loudness ("gain = auto"), or not ("fixed")
+    CaptureProfile capture = CaptureProfile::Full;
+    CaptureBackendKind backend = CaptureBackendKind::Auto;
+    int stats_interval = 0; // seconds between stats dumps to stderr, 0 = off
+    // Bar colors as gradient stops ("at:#rrggbb[aa], ...", '#' optional, see
+    // Palette::parse), or empty for the build's theme.
+    std::vector<GradientStop> gradient;
+    int idle_after = 5; // seconds of digital silence before capture and redraws pause, 0 = never
+    // Headless input instead of the sound server: a generator (sweep, pink,
+    // silence, impulse) or a WAV/raw file, looped. Empty = live capture.
+    std::string source;
+    bool paced = true; // hand source audio over in real time, or as fast as it is drained
+    // Capture recordings (recording.h): record copies whatever is captured
+    // to a file, replay plays one back instead of capturing. Empty = off.
+    std::string record;
+    std::string replay;
+
+    // Applies one setting; returns false for unknown keys or bad values.
+    bool set(const std::string& key, const std::string& value) {
+        if (key == "bars") {
+            int n = std::atoi(value.c_str());
+            if (n < 1 || n > 512) return false;
+            bars = n;
+        } else if (key == "fps") {
+            int n = std::atoi(value.c_str());
+            if (n < 1 || n > 240) return false;
+            fps = n;
+        } else if (key == "scale") {
+            if (value == "log") scale = BandScale::Log;
+            else if (value == "mel") scale = BandScale::Mel;
+            else return false;
+        } else if (key == "stats") {
+            int n = std::atoi(value.c_str());
+            if (n < 0) return false;
+            stats_interval = n;
+        } else if (key == "idle") {
+            int n = std::atoi(value.c_str());
+            if (n < 0) return false;
+            idle_after = n;
+        } else if (key == "gradient") {
+            if (!Palette::parse(value, gradient)) return false;
+        } else if (key == "layout") {
+            if (value == "spectrum") layout = BarLayout::Spectrum;
+            else if (value == "mirror") layout = BarLayout::Mirror;
+            else return false;
+        } else if (key == "mode") {
+            if (value == "bars") mode = ViewMode::Bars;
+            else if (value == "radial") mode = ViewMode::Radial;
+            else if (value == "waterfall") mode = ViewMode::Waterfall;
+            else if (value == "scope") mode = ViewMode::Scope;
+            else return false;
+        } else if (key == "share") {
+            if (value == "off") share = ShareMode::Off;
+            else if (value == "publish") share = ShareMode::Publish;
+            else if (value == "subscribe") share = ShareMode::Subscribe;
+            else return false;
+        } else if (key == "gain") {
+            if (value == "auto") auto_gain = true;
+            else if (value == "fixed") auto_gain = false;
+            else return false;
+        } else if (key == "backend") {
+            if (value == "auto") backend = CaptureBackendKind::Auto;
+            else if (value == "pulse") backend = CaptureBackendKind::Pulse;
+            else if (value == "pipewire") backend = CaptureBackendKind::PipeWire;
+            else return false;
+        } else if (key == "source") {
+            source = value;
+        } else if (key == "record") {
+            record = value;
+        } else if (key == "replay") {
+            replay = value;
+        } else if (key == "pace") {
+            if (value == "realtime") paced = true;
+            else if (value == "fast") paced = false;
+            else return false;
+        } else if (key == "capture") {
+            if (value == "full") capture = CaptureProfile::Full;
+            else if (value == "compact") capture = CaptureProfile::Compact;
+            else if (value == "peaks") capture = CaptureProfile::Peaks;
+            else return false;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void load_file(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            // A comment starts the line or follows whitespace, so values
+            // like gradient colors keep their '#'.
+            for (size_t hash = line.find('#'); hash != std::string::npos; hash = line.find('#', hash + 1)) {
+                if (hash == 0 || line[hash - 1] == ' ' || line[hash - 1] == '\t') {
+                    line.erase(hash);
+                    break;
+                }
+            }
+            size_t eq = line.find('=');
+            if (eq == std::string::npos) continue;
+            std::string key = trim(line.substr(0, eq));
+            std::string value = trim(line.substr(eq + 1));
+            if (!set(key, value)) {
+                std::cerr << path << ": ignoring " << key << " = " << value << "\n";
+            }
+        }
+    }
+
+    void parse_args(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 2, "--") != 0) {
+                std::cerr << "Ignoring argument " << arg << "\n";
+                continue;
+            }
+            std::string key = arg.substr(2), value;
+            size_t eq = key.find('=');
+            if (eq != std::string::npos) {
+                value = key.substr(eq + 1);
+                key.erase(eq);
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            }
+            if (!set(key, value)) {
+                std::cerr << "Ignoring --" << key << " " << value << "\n";
+            }
+        }
+    }
+
+    static VisualizerConfig load(int argc, char* argv[]) {
+        VisualizerConfig config;
+        const char* home = std::getenv("HOME");
+        config.load_file(std::string(home ? home : "") + "/.config/Elysia/widgets/visualizer/visualizer.conf");
+        config.parse_args(argc, argv);
+        return config;
+    }
+
+private:
+    static std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t\r");
+        size_t e = s.find_last_not_of(" \t\r");
+        return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+    }
+};
@@ -0,0 +1,82 @@
+// Checks for VisualizerConfig's file and argument parsing. Needs no audio
+// server or display: run ./visualizer-config-test, exits non-zero on a
+// failure after saying which.
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "config.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    if (ok) return;
+    std::fprintf(stderr, "FAIL: %s\n", what);
+    ++failures;
+}
+
+// Writes text to a fresh temporary file and loads it into a default config.
+VisualizerConfig load_text(const std::string& text) {
+    char path[] = "/tmp/visualizer-config-test-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        std::perror("mkstemp");
+        std::exit(2);
+    }
+    close(fd);
+    std::ofstream(path) << text;
+    VisualizerConfig config;
+    config.load_file(path);
+    unlink(path);
+    return config;
+}
+
+bool same(const BarColor& c, double r, double g, double b, double a) {
+    auto near = [](double x, double y) { return x > y - 1e-9 && x < y + 1e-9; };
+    return near(c.r, r) && near(c.g, g) && near(c.b, b) && near(c.a, a);
+}
+
+void test_gradient_from_file() {
+    VisualizerConfig c = load_text("gradient = 0:#112233,1:#ffeeff80\n");
+    check(c.gradient.size() == 2, "gradient with '#' colors loads from a file");
+    if (c.gradient.size() == 2) {
+        check(c.gradient[0].at == 0.0f && same(c.gradient[0].color, 0x11 / 255.0, 0x22 / 255.0, 0x33 / 255.0, 1.0),
+              "first gradient stop");
+        check(c.gradient[1].at == 1.0f
+                  && same(c.gradient[1].color, 0xff / 255.0, 0xee / 255.0, 0xff / 255.0, 0x80 / 255.0),
+              "second gradient stop keeps its alpha");
+    }
+}
+
+void test_comments() {
+    VisualizerConfig c = load_text("# bars = 10\n"
+                                   "bars = 64 # more bars\n"
+                                   "gradient = 0:#000000, 0.5:#ff0000, 1:#ffffff\t# three stops\n"
+                                   "source = take#2.wav\n");
+    check(c.bars == 64, "trailing comment after whitespace is stripped");
+    check(c.gradient.size() == 3, "comment after a gradient is stripped, its colors kept");
+    check(c.source == "take#2.wav", "'#' inside a value is not a comment");
+}
+
+void test_gradient_without_hash() {
+    std::vector<GradientStop> stops;
+    check(Palette::parse("0:112233, 1: ffeeff", stops) && stops.size() == 2, "colors without '#' parse");
+    check(!Palette::parse("0:#1122", stops), "short color is rejected");
+    check(!Palette::parse("0:", stops), "missing color is rejected");
+    check(!Palette::parse("2:#112233", stops), "stop beyond 1 is rejected");
+}
+
+} // namespace
+
+int main() {
+    test_gradient_from_file();
+    test_comments();
+    test_gradient_without_hash();
+    if (failures == 0) std::printf("config: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// constexpr math used to bake window and band tables into the binary. These
+// are plain Taylor series with range reduction: accurate to well below float
+// precision over the ranges the tables need, and usable at runtime for the
+// sizes that have no precomputed table.
+namespace dsp {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kLn2 = 0.69314718055994530942;
+constexpr double kLn10 = 2.30258509299404568402;
+
+constexpr double cos(double x) {
+    // Reduce to [-pi, pi].
+    long turns = (long)(x / (2.0 * kPi));
+    x -= turns * 2.0 * kPi;
+    if (x > kPi) x -= 2.0 * kPi;
+    if (x < -kPi) x += 2.0 * kPi;
+    double term = 1.0, sum = 1.0, x2 = x * x;
+    for (int k = 1; k < 20; ++k) {
+        term *= -x2 / ((2 * k - 1) * (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double exp(double x) {
+    // e^x = 2^k * e^r with |r| <= ln2 / 2.
+    long k = (long)(x / kLn2 + (x < 0 ? -0.5 : 0.5));
+    double r = x - k * kLn2;
+    double term = 1.0, sum = 1.0;
+    for (int i = 1; i < 20; ++i) {
+        term *= r / i;
+        sum += term;
+    }
+    for (; k > 0; --k) sum *= 2.0;
+    for (; k < 0; ++k) sum *= 0.5;
+    return sum;
+}
+
+constexpr double log(double x) {
+    // x = m * 2^k with m in [0.75, 1.5), then ln m = 2 atanh((m-1)/(m+1)).
+    long k = 0;
+    while (x >= 1.5) { x *= 0.5; ++k; }
+    while (x < 0.75) { x *= 2.0; --k; }
+    double t = (x - 1.0) / (x + 1.0), t2 = t * t;
+    double term = t, sum = 0.0;
+    for (int i = 1; i < 40; i += 2) {
+        sum += term / i;
+        term *= t2;
+    }
+    return 2.0 * sum + k * kLn2;
+}
+
+enum class WindowShape { Hann, Blackman };
+
+constexpr double window_at(WindowShape shape, size_t i, size_t n) {
+    double p = 2.0 * kPi * i / (n - 1);
+    return shape == WindowShape::Hann
+        ? 0.5 - 0.5 * dsp::cos(p)
+        : 0.42 - 0.5 * dsp::cos(p) + 0.08 * dsp::cos(2.0 * p);
+}
+
+template <size_t N, WindowShape Shape>
+constexpr std::array<float, N> make_window() {
+    std::array<float, N> w{};
+    for (size_t i = 0; i < N; ++i) w[i] = (float)window_at(Shape, i, N);
+    return w;
+}
+
+template <size_t N, WindowShape Shape>
+struct WindowTable {
+    static constexpr std::array<float, N> values = make_window<N, Shape>();
+};
+
+// Precomputed windows for the FFT sizes the visualizer uses; nullptr for
+// anything else.
+inline const float* find_window(size_t n, WindowShape shape) {
+    bool hann = shape == WindowShape::Hann;
+    switch (n) {
+    case 1024:
+        return hann ? WindowTable<1024, WindowShape::Hann>::values.data()
+                    : WindowTable<1024, WindowShape::Blackman>::values.data();
+    case 2048:
+        return hann ? WindowTable<2048, WindowShape::Hann>::values.data()
+                    : WindowTable<2048, WindowShape::Blackman>::values.data();
+    default:
+        return nullptr;
+    }
+}
+
+} // namespace dsp
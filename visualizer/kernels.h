@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VISUALIZER_X86 1
+#endif
+
+// Per-fragment level kernels: absolute peak, RMS and per-channel peak of an
+// interleaved buffer, and the signed min/max of a mono run (the scope's
+// per-column decimation). The scalar versions are the reference; on x86 the
+// SSE2 and AVX2 versions are compiled alongside via target attributes (no -m
+// flags needed) and the fastest one the CPU supports is picked once at
+// startup.
+namespace kernels {
+
+struct Set {
+    const char* name;
+    float (*abs_peak)(const float* samples, size_t count);
+    float (*rms)(const float* samples, size_t count);
+    // out receives one peak per channel; frames are interleaved.
+    void (*channel_peaks)(const float* frames, size_t count, unsigned channels, float* out);
+    // Smallest and largest sample; count must be at least 1.
+    void (*min_max)(const float* samples, size_t count, float* lo, float* hi);
+};
+
+// Scalar reference
+
+inline float abs_peak_scalar(const float* s, size_t n) {
+    float m = 0.0f;
+    for (size_t i = 0; i < n; ++i) m = std::max(m, std::abs(s[i]));
+    return m;
+}
+
+inline float rms_scalar(const float* s, size_t n) {
+    if (n == 0) return 0.0f;
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) sum += (double)s[i] * s[i];
+    return (float)std::sqrt(sum / n);
+}
+
+inline void channel_peaks_scalar(const float* f, size_t frames, unsigned channels, float* out) {
+    std::fill(out, out + channels, 0.0f);
+    for (size_t i = 0; i < frames; ++i) {
+        for (unsigned c = 0; c < channels; ++c) {
+            out[c] = std::max(out[c], std::abs(f[i * channels + c]));
+        }
+    }
+}
+
+inline void min_max_scalar(const float* s, size_t n, float* lo, float* hi) {
+    float a = s[0], b = s[0];
+    for (size_t i = 1; i < n; ++i) {
+        a = std::min(a, s[i]);
+        b = std::max(b, s[i]);
+    }
+    *lo = a;
+    *hi = b;
+}
+
+inline const Set& scalar() {
+    static const Set set = {"scalar", abs_peak_scalar, rms_scalar, channel_peaks_scalar, min_max_scalar};
+    return set;
+}
+
+#ifdef VISUALIZER_X86
+
+// SSE2
+
+__attribute__((target("sse2")))
+inline __m128 abs_ps_sse2(__m128 v) {
+    return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+__attribute__((target("sse2")))
+inline float hmax_sse2(__m128 v) {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+__attribute__((target("sse2")))
+inline float abs_peak_sse2(const float* s, size_t n) {
+    __m128 m0 = _mm_setzero_ps(), m1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        m0 = _mm_max_ps(m0, abs_ps_sse2(_mm_loadu_ps(s + i)));
+        m1 = _mm_max_ps(m1, abs_ps_sse2(_mm_loadu_ps(s + i + 4)));
+    }
+    float m = hmax_sse2(_mm_max_ps(m0, m1));
+    return std::max(m, abs_peak_scalar(s + i, n - i));
+}
+
+__attribute__((target("sse2")))
+inline float rms_sse2(const float* s, size_t n) {
+    if (n == 0) return 0.0f;
+    __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 v0 = _mm_loadu_ps(s + i), v1 = _mm_loadu_ps(s + i + 4);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(v0, v0));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(v1, v1));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(a0, a1));
+    double sum = (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; ++i) sum += (double)s[i] * s[i];
+    return (float)std::sqrt(sum / n);
+}
+
+__attribute__((target("sse2")))
+inline void channel_peaks_sse2(const float* f, size_t frames, unsigned channels, float* out) {
+    // Stereo lanes alternate L R L R, so one running max per lane keeps the
+    // channels apart and they are folded at the end. Other layouts go scalar.
+    if (channels != 2) {
+        if (channels == 1) out[0] = abs_peak_sse2(f, frames);
+        else channel_peaks_scalar(f, frames, channels, out);
+        return;
+    }
+    size_t n = frames * 2, i = 0;
+    __m128 m = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4) m = _mm_max_ps(m, abs_ps_sse2(_mm_loadu_ps(f + i)));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, m);
+    out[0] = std::max(lanes[0], lanes[2]);
+    out[1] = std::max(lanes[1], lanes[3]);
+    for (; i < n; i += 2) {
+        out[0] = std::max(out[0], std::abs(f[i]));
+        out[1] = std::max(out[1], std::abs(f[i + 1]));
+    }
+}
+
+__attribute__((target("sse2")))
+inline float hmin_sse2(__m128 v) {
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+
+__attribute__((target("sse2")))
+inline void min_max_sse2(const float* s, size_t n, float* lo, float* hi) {
+    if (n < 4) {
+        min_max_scalar(s, n, lo, hi);
+        return;
+    }
+    __m128 a = _mm_loadu_ps(s), b = a;
+    size_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(s + i);
+        a = _mm_min_ps(a, v);
+        b = _mm_max_ps(b, v);
+    }
+    // The last (possibly overlapping) vector covers the tail.
+    __m128 v = _mm_loadu_ps(s + n - 4);
+    *lo = hmin_sse2(_mm_min_ps(a, v));
+    *hi = hmax_sse2(_mm_max_ps(b, v));
+}
+
+inline const Set& sse2() {
+    static const Set set = {"sse2", abs_peak_sse2, rms_sse2, channel_peaks_sse2, min_max_sse2};
+    return set;
+}
+
+// AVX2
+
+__attribute__((target("avx2")))
+inline __m256 abs_ps_avx2(__m256 v) {
+    return _mm256_and_ps(v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+}
+
+__attribute__((target("avx2")))
+inline float abs_peak_avx2(const float* s, size_t n) {
+    __m256 m0 = _mm256_setzero_ps(), m1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        m0 = _mm256_max_ps(m0, abs_ps_avx2(_mm256_loadu_ps(s + i)));
+        m1 = _mm256_max_ps(m1, abs_ps_avx2(_mm256_loadu_ps(s + i + 8)));
+    }
+    __m256 m = _mm256_max_ps(m0, m1);
+    float r = hmax_sse2(_mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1)));
+    return std::max(r, abs_peak_sse2(s + i, n - i));
+}
+
+__attribute__((target("avx2,fma")))
+inline float rms_avx2(const float* s, size_t n) {
+    if (n == 0) return 0.0f;
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 v0 = _mm256_loadu_ps(s + i), v1 = _mm256_loadu_ps(s + i + 8);
+        a0 = _mm256_fmadd_ps(v0, v0, a0);
+        a1 = _mm256_fmadd_ps(v1, v1, a1);
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(a0, a1));
+    double sum = 0.0;
+    for (float l : lanes) sum += l;
+    for (; i < n; ++i) sum += (double)s[i] * s[i];
+    return (float)std::sqrt(sum / n);
+}
+
+__attribute__((target("avx2")))
+inline void channel_peaks_avx2(const float* f, size_t frames, unsigned channels, float* out) {
+    if (channels != 2) {
+        if (channels == 1) out[0] = abs_peak_avx2(f, frames);
+        else channel_peaks_scalar(f, frames, channels, out);
+        return;
+    }
+    size_t n = frames * 2, i = 0;
+    __m256 m = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8) m = _mm256_max_ps(m, abs_ps_avx2(_mm256_loadu_ps(f + i)));
+    __m128 h = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, h);
+    out[0] = std::max(lanes[0], lanes[2]);
+    out[1] = std::max(lanes[1], lanes[3]);
+    for (; i < n; i += 2) {
+        out[0] = std::max(out[0], std::abs(f[i]));
+        out[1] = std::max(out[1], std::abs(f[i + 1]));
+    }
+}
+
+__attribute__((target("avx2")))
+inline void min_max_avx2(const float* s, size_t n, float* lo, float* hi) {
+    if (n < 8) {
+        min_max_sse2(s, n, lo, hi);
+        return;
+    }
+    __m256 a = _mm256_loadu_ps(s), b = a;
+    size_t i = 8;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(s + i);
+        a = _mm256_min_ps(a, v);
+        b = _mm256_max_ps(b, v);
+    }
+    __m256 v = _mm256_loadu_ps(s + n - 8);
+    a = _mm256_min_ps(a, v);
+    b = _mm256_max_ps(b, v);
+    *lo = hmin_sse2(_mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+    *hi = hmax_sse2(_mm_max_ps(_mm256_castps256_ps128(b), _mm256_extractf128_ps(b, 1)));
+}
+
+inline const Set& avx2() {
+    static const Set set = {"avx2", abs_peak_avx2, rms_avx2, channel_peaks_avx2, min_max_avx2};
+    return set;
+}
+
+#endif // VISUALIZER_X86
+
+// The fastest set this CPU can run, resolved once.
+inline const Set& best() {
+    static const Set& set = []() -> const Set& {
+#ifdef VISUALIZER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return avx2();
+        if (__builtin_cpu_supports("sse2")) return sse2();
+#endif
+        return scalar();
+    }();
+    return set;
+}
+
+} // namespace kernels
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+
+// Log-scale histogram of durations in microseconds: four buckets per octave
+// from 1 us to ~16 s, so percentiles are good to ~19% at any magnitude and
+// adding a sample is a log2 and an increment. Single-threaded; the widget
+// fills these on the GTK thread.
+class LatencyHistogram {
+public:
+    void add(double us) {
+        ++buckets[bucket_of(us)];
+        ++count;
+        sum_us += us;
+        max_us = std::max(max_us, us);
+    }
+
+    uint64_t get_count() const { return count; }
+
+    // Upper edge of the bucket holding the q-th quantile (0..1).
+    double percentile(double q) const {
+        uint64_t rank = (uint64_t)std::ceil(q * count);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank && seen > 0) return std::min(upper_edge(i), max_us);
+        }
+        return max_us;
+    }
+
+    void dump(std::ostream& out, const char* name) const {
+        out << "latency " << name << ": n=" << count;
+        if (count > 0) {
+            out << " avg_us=" << (uint64_t)(sum_us / count) << " p50_us=" << (uint64_t)percentile(0.5)
+                << " p90_us=" << (uint64_t)percentile(0.9) << " p99_us=" << (uint64_t)percentile(0.99)
+                << " max_us=" << (uint64_t)max_us;
+        }
+        out << "\n";
+    }
+
+private:
+    static constexpr int kPerOctave = 4;
+    static constexpr size_t kBuckets = 24 * kPerOctave + 1;
+
+    std::array<uint64_t, kBuckets> buckets = {};
+    uint64_t count = 0;
+    double sum_us = 0.0;
+    double max_us = 0.0;
+
+    // Bucket 0 is everything under 1 us (including clock skew below zero).
+    static size_t bucket_of(double us) {
+        if (!(us >= 1.0)) return 0;
+        return std::min(kBuckets - 1, (size_t)(std::log2(us) * kPerOctave) + 1);
+    }
+
+    static double upper_edge(size_t bucket) { return std::exp2((double)bucket / kPerOctave); }
+};
+
+// Where a sample of audio spends its time between the device and the screen.
+// Each stage is the gap between two timestamps on the steady clock (which is
+// CLOCK_MONOTONIC, the same clock GDK's frame timings use):
+//
+//   stream    device to deliver(): server/graph buffering, from the backend
+//   ring      deliver() of the newest frame to the analysis picking it up
+//   analysis  the Analyzer::update() that consumed it
+//   draw      analysis done to the start of the draw that shows it
+//   present   draw start to the frame being presented (compositor-reported)
+//   total     device to photon, the sum of the above
+struct LatencyStages {
+    LatencyHistogram stream, ring, analysis, draw, present, total;
+
+    void dump(std::ostream& out) const {
+        stream.dump(out, "stream");
+        ring.dump(out, "ring");
+        analysis.dump(out, "analysis");
+        draw.dump(out, "draw");
+        present.dump(out, "present");
+        total.dump(out, "total");
+    }
+};
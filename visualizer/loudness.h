@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "kernels.h"
+
+// EBU R128 / ITU-R BS.1770 loudness: K-weighting (a high shelf for the head,
+// then a ~38 Hz high-pass) and mean square per channel over 100 ms blocks.
+// Momentary loudness covers the last 400 ms, short-term the last 3 s. Both
+// are ungated, as R128 specifies for these two; only integrated loudness
+// gates, and the visualizer has no use for it.
+//
+// The two biquads run in double precision, transposed direct form II. For
+// stereo the SSE2 path keeps left and right in the two lanes of one
+// register, so both channels cost one filter's worth of instructions; other
+// layouts and non-x86 builds take the scalar loop.
+namespace loudness {
+
+struct Biquad {
+    double b0, b1, b2, a1, a2;
+};
+
+// The BS.1770 filters are specified at 48 kHz; these are the same analog
+// prototypes bilinear-transformed for any rate (as libebur128 does).
+inline std::array<Biquad, 2> k_weighting(unsigned rate) {
+    double f0 = 1681.974450955533, gain_db = 3.999843853973347, q = 0.7071752369554196;
+    double k = std::tan(M_PI * f0 / rate);
+    double vh = std::pow(10.0, gain_db / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    Biquad shelf = {(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                    2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(M_PI * f0 / rate);
+    a0 = 1.0 + k / q + k * k;
+    Biquad highpass = {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+    return {shelf, highpass};
+}
+
+// Filter state: z1/z2 of both stages, one lane per channel.
+struct State {
+    static constexpr unsigned kMaxChannels = 2;
+    alignas(16) double z[2][2][kMaxChannels]; // [stage][z1, z2][channel]
+};
+
+// Runs frames through both stages and adds each channel's squared output to
+// sum[channel].
+inline void process_scalar(const std::array<Biquad, 2>& f, State& st, const float* frames,
+                           size_t count, unsigned channels, double* sum) {
+    for (unsigned c = 0; c < channels; ++c) {
+        double z10 = st.z[0][0][c], z20 = st.z[0][1][c];
+        double z11 = st.z[1][0][c], z21 = st.z[1][1][c];
+        double acc = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            double x = frames[i * channels + c];
+            double y = f[0].b0 * x + z10;
+            z10 = f[0].b1 * x - f[0].a1 * y + z20;
+            z20 = f[0].b2 * x - f[0].a2 * y;
+            double w = f[1].b0 * y + z11;
+            z11 = f[1].b1 * y - f[1].a1 * w + z21;
+            z21 = f[1].b2 * y - f[1].a2 * w;
+            acc += w * w;
+        }
+        st.z[0][0][c] = z10;
+        st.z[0][1][c] = z20;
+        st.z[1][0][c] = z11;
+        st.z[1][1][c] = z21;
+        sum[c] += acc;
+    }
+}
+
+#ifdef VISUALIZER_X86
+
+__attribute__((target("sse2")))
+inline void process_stereo_sse2(const std::array<Biquad, 2>& f, State& st, const float* frames,
+                                size_t count, unsigned, double* sum) {
+    const __m128d b00 = _mm_set1_pd(f[0].b0), b01 = _mm_set1_pd(f[0].b1), b02 = _mm_set1_pd(f[0].b2);
+    const __m128d a01 = _mm_set1_pd(f[0].a1), a02 = _mm_set1_pd(f[0].a2);
+    const __m128d b10 = _mm_set1_pd(f[1].b0), b11 = _mm_set1_pd(f[1].b1), b12 = _mm_set1_pd(f[1].b2);
+    const __m128d a11 = _mm_set1_pd(f[1].a1), a12 = _mm_set1_pd(f[1].a2);
+    __m128d z10 = _mm_load_pd(st.z[0][0]), z20 = _mm_load_pd(st.z[0][1]);
+    __m128d z11 = _mm_load_pd(st.z[1][0]), z21 = _mm_load_pd(st.z[1][1]);
+    __m128d acc = _mm_setzero_pd();
+    for (size_t i = 0; i < count; ++i) {
+        // One L/R frame is 8 bytes: load it as a double and widen both floats.
+        __m128 lr = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(frames + 2 * i)));
+        __m128d x = _mm_cvtps_pd(lr);
+        __m128d y = _mm_add_pd(_mm_mul_pd(b00, x), z10);
+        z10 = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(b01, x), z20), _mm_mul_pd(a01, y));
+        z20 = _mm_sub_pd(_mm_mul_pd(b02, x), _mm_mul_pd(a02, y));
+        __m128d w = _mm_add_pd(_mm_mul_pd(b10, y), z11);
+        z11 = _mm_sub_pd(_mm_add_pd(_mm_mul_pd(b11, y), z21), _mm_mul_pd(a11, w));
+        z21 = _mm_sub_pd(_mm_mul_pd(b12, y), _mm_mul_pd(a12, w));
+        acc = _mm_add_pd(acc, _mm_mul_pd(w, w));
+    }
+    _mm_store_pd(st.z[0][0], z10);
+    _mm_store_pd(st.z[0][1], z20);
+    _mm_store_pd(st.z[1][0], z11);
+    _mm_store_pd(st.z[1][1], z21);
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, acc);
+    sum[0] += lanes[0];
+    sum[1] += lanes[1];
+}
+
+#endif // VISUALIZER_X86
+
+} // namespace loudness
+
+// Momentary and short-term loudness of the captured audio, updated as
+// fragments are fed. Everything is allocated at construction.
+class LoudnessMeter {
+public:
+    // Quieter than this reads as silence (the R128 absolute gate).
+    static constexpr double kSilenceLufs = -70.0;
+
+    LoudnessMeter(unsigned rate, unsigned channels)
+        : filters(loudness::k_weighting(rate)), channels(std::min(channels, loudness::State::kMaxChannels)),
+          in_channels(channels), block_frames(std::max(1u, rate / 10)), blocks(kShortTermBlocks, 0.0) {
+        process = loudness::process_scalar;
+#ifdef VISUALIZER_X86
+        if (this->channels == 2 && in_channels == 2 && __builtin_cpu_supports("sse2")) {
+            process = loudness::process_stereo_sse2;
+            simd = true;
+        }
+#endif
+    }
+
+    // Consumes interleaved frames. Only the first two channels count (BS.1770
+    // weights L and R by 1; the visualizer never captures surround). Mono is
+    // a downmix of the stereo monitor, so it counts as dual mono and reads
+    // what the stereo stream would.
+    void feed(const float* frames, size_t count) {
+        while (count > 0) {
+            size_t take = std::min(count, block_frames - block_fill);
+            if (in_channels == channels) {
+                process(filters, state, frames, take, channels, block_sum.data());
+            } else {
+                for (size_t i = 0; i < take; ++i) {
+                    process(filters, state, frames + i * in_channels, 1, channels, block_sum.data());
+                }
+            }
+            frames += take * in_channels;
+            count -= take;
+            block_fill += take;
+            if (block_fill == block_frames) close_block();
+        }
+    }
+
+    // LUFS over the last 400 ms and 3 s; kSilenceLufs or below when silent.
+    double momentary() const { return lufs(kMomentaryBlocks); }
+    double short_term() const { return lufs(kShortTermBlocks); }
+    bool is_simd() const { return simd; }
+
+private:
+    static constexpr size_t kMomentaryBlocks = 4;  // 400 ms
+    static constexpr size_t kShortTermBlocks = 30; // 3 s
+
+    std::array<loudness::Biquad, 2> filters;
+    loudness::State state = {};
+    void (*process)(const std::array<loudness::Biquad, 2>&, loudness::State&, const float*, size_t,
+                    unsigned, double*);
+    bool simd = false;
+    unsigned channels, in_channels;
+    size_t block_frames;
+    size_t block_fill = 0;
+    std::array<double, loudness::State::kMaxChannels> block_sum = {};
+    std::vector<double> blocks; // mean square summed over channels, ring of 100 ms blocks
+    size_t blocks_done = 0;
+
+    void close_block() {
+        double power = 0.0;
+        for (unsigned c = 0; c < channels; ++c) power += block_sum[c] / block_frames;
+        if (channels == 1) power *= 2.0;
+        blocks[blocks_done % kShortTermBlocks] = power;
+        ++blocks_done;
+        block_sum.fill(0.0);
+        block_fill = 0;
+    }
+
+    double lufs(size_t window) const {
+        size_t n = std::min(window, blocks_done);
+        if (n == 0) return kSilenceLufs - 1.0;
+        double power = 0.0;
+        for (size_t i = 1; i <= n; ++i) power += blocks[(blocks_done - i) % kShortTermBlocks];
+        power /= n;
+        return power > 0.0 ? -0.691 + 10.0 * std::log10(power) : kSilenceLufs - 1.0;
+    }
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Pixels are CAIRO_FORMAT_ARGB32: premultiplied alpha, native-endian 32-bit
+// words.
+namespace raster {
+
+// Premultiplied ARGB32 from straight 0..1 components.
+inline uint32_t pack(double r, double g, double b, double a) {
+    auto channel = [a](double v) { return (uint32_t)(std::clamp(v * a, 0.0, 1.0) * 255.0 + 0.5); };
+    return (uint32_t)(std::clamp(a, 0.0, 1.0) * 255.0 + 0.5) << 24 | channel(r) << 16 | channel(g) << 8 | channel(b);
+}
+
+// Premultiplied src OVER dst, per channel with rounding.
+inline uint32_t over(uint32_t src, uint32_t dst) {
+    uint32_t inv = 255 - (src >> 24);
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t d = (dst >> shift & 0xff) * inv + 128;
+        out |= std::min(255u, (src >> shift & 0xff) + ((d + (d >> 8)) >> 8)) << shift;
+    }
+    return out;
+}
+
+} // namespace raster
+
+struct BarColor {
+    double r, g, b, a;
+};
+
+// One point of a bar gradient: the color bars have at this intensity (0..1).
+struct GradientStop {
+    float at;
+    BarColor color;
+};
+
+// Bar colors by intensity, precomputed from gradient stops into a 256-entry
+// table of premultiplied ARGB32 (the bar raster's pixel format), along with
+// the same colors under the white top highlight. Drawing a bar is then a
+// table lookup at its quantized intensity: no branches, no blending. The
+// straight colors are kept too, for the layouts Cairo fills.
+class Palette {
+public:
+    static constexpr int kSize = 256;
+
+    explicit Palette(std::vector<GradientStop> stops) {
+        std::sort(stops.begin(), stops.end(), [](const GradientStop& a, const GradientStop& b) { return a.at < b.at; });
+        if (stops.empty()) stops.push_back({0.0f, {1.0, 1.0, 1.0, 1.0}});
+        const uint32_t highlight = raster::pack(1.0, 1.0, 1.0, 0.6);
+        for (int i = 0; i < kSize; ++i) {
+            BarColor c = sample(stops, (float)i / (kSize - 1));
+            colors[i] = c;
+            fills[i] = raster::pack(c.r, c.g, c.b, c.a);
+            lits[i] = raster::over(highlight, fills[i]);
+        }
+    }
+
+    // Table index of an intensity in 0..1 (out-of-range values clamp).
+    static uint8_t index(float intensity) {
+        return (uint8_t)std::clamp((int)(intensity * (kSize - 1) + 0.5f), 0, kSize - 1);
+    }
+
+    uint32_t fill(uint8_t i) const { return fills[i]; }
+    uint32_t lit(uint8_t i) const { return lits[i]; }
+    const BarColor& color(uint8_t i) const { return colors[i]; }
+
+    // "at:#rrggbb[aa], ..." with at in 0..1, e.g. "0:#ffbfcce6, 1:#ff3399e6".
+    // The '#' may be left out ("0:ffbfcce6"). Returns false (leaving stops
+    // alone) on anything malformed.
+    static bool parse(const std::string& text, std::vector<GradientStop>& stops) {
+        std::vector<GradientStop> parsed;
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t comma = text.find(',', pos);
+            std::string item = text.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+            pos = comma == std::string::npos ? text.size() : comma + 1;
+
+            size_t colon = item.find(':');
+            if (colon == std::string::npos) return false;
+            char* end;
+            float at = std::strtof(item.c_str(), &end);
+            if (end == item.c_str() || at < 0.0f || at > 1.0f) return false;
+            size_t hex_start = item.find_first_not_of(" \t", colon + 1);
+            if (hex_start == std::string::npos) return false;
+            if (item[hex_start] == '#') ++hex_start;
+            std::string hex = item.substr(hex_start);
+            hex.erase(hex.find_last_not_of(" \t") + 1);
+            if (hex.size() != 6 && hex.size() != 8) return false;
+            if (hex.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) return false;
+            unsigned long v = std::strtoul(hex.c_str(), nullptr, 16);
+            if (hex.size() == 6) v = v << 8 | 0xff;
+            parsed.push_back({at, {(v >> 24 & 0xff) / 255.0, (v >> 16 & 0xff) / 255.0,
+                                   (v >> 8 & 0xff) / 255.0, (v & 0xff) / 255.0}});
+        }
+        if (parsed.empty()) return false;
+        stops = std::move(parsed);
+        return true;
+    }
+
+private:
+    std::array<uint32_t, kSize> fills;
+    std::array<uint32_t, kSize> lits;
+    std::array<BarColor, kSize> colors;
+
+    // Straight (not premultiplied) interpolation between the neighbouring
+    // stops; flat beyond the first and last.
+    static BarColor sample(const std::vector<GradientStop>& stops, float t) {
+        if (t <= stops.front().at) return stops.front().color;
+        for (size_t i = 1; i < stops.size(); ++i) {
+            if (t > stops[i].at) continue;
+            const GradientStop& a = stops[i - 1];
+            const GradientStop& b = stops[i];
+            double f = b.at > a.at ? (t - a.at) / (b.at - a.at) : 1.0;
+            return {a.color.r + (b.color.r - a.color.r) * f, a.color.g + (b.color.g - a.color.g) * f,
+                    a.color.b + (b.color.b - a.color.b) * f, a.color.a + (b.color.a - a.color.a) * f};
+        }
+        return stops.back().color;
+    }
+};
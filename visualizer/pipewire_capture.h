@@ -0,0 +1,227 @@
+#pragma once
+
+#include <pipewire/pipewire.h>
+#include <spa/param/audio/format-utils.h>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+
+#include "capture.h"
+
+// Captures the default sink's monitor with a native pw_stream, skipping the
+// pipewire-pulse translation hop and its extra buffering. The stream runs its
+// process callback on PipeWire's data thread and pushes straight into the
+// ring. PW_KEY_STREAM_CAPTURE_SINK makes the session manager link us to
+// whatever the default sink is, and relink us when it changes.
+//
+// If the daemon goes away (a core error) or the stream fails, the core and
+// stream are torn down and rebuilt on a timer with the same exponential
+// backoff PulseCapture uses; the backoff resets once the stream streams.
+//
+// Paused deactivates the stream, so the graph stops scheduling it. Watching
+// keeps it running and deliver() listens: the graph wakes us once per
+// quantum either way, and a peak over one quantum is all it costs.
+class PipeWireCapture : public CaptureBackend {
+public:
+    // Returns nullptr when no PipeWire daemon is reachable.
+    static std::unique_ptr<PipeWireCapture> create(CaptureProfile profile) {
+        std::unique_ptr<PipeWireCapture> capture(new PipeWireCapture(profile));
+        if (!capture->core) return nullptr;
+        pw_thread_loop_start(capture->loop);
+        return capture;
+    }
+
+    ~PipeWireCapture() override {
+        if (loop) pw_thread_loop_stop(loop);
+        if (retry_timer) pw_loop_destroy_source(pw_thread_loop_get_loop(loop), retry_timer);
+        close_core();
+        if (context) pw_context_destroy(context);
+        if (loop) pw_thread_loop_destroy(loop);
+        pw_deinit();
+    }
+
+    const char* get_name() const override { return "pipewire"; }
+
+protected:
+    void on_activity(Activity a) override {
+        pw_thread_loop_lock(loop);
+        if (stream) pw_stream_set_active(stream, a != Activity::Paused);
+        pw_thread_loop_unlock(loop);
+    }
+
+private:
+    static constexpr unsigned kMinBackoffMs = 250;
+    static constexpr unsigned kMaxBackoffMs = 10000;
+
+    pw_thread_loop* loop = nullptr;
+    pw_context* context = nullptr;
+    pw_core* core = nullptr;
+    pw_stream* stream = nullptr;
+    spa_source* retry_timer = nullptr;
+    spa_hook core_listener;
+    pw_core_events core_events;
+    spa_hook stream_listener;
+    pw_stream_events events;
+    spa_audio_format format;
+    unsigned capture_rate;
+    unsigned capture_channels;
+    unsigned backoff_ms = 0;
+
+    explicit PipeWireCapture(CaptureProfile profile)
+        : CaptureBackend(profile, profile_channels(profile), profile_rate(profile)) {
+        format = profile == CaptureProfile::Compact ? SPA_AUDIO_FORMAT_S16_LE : SPA_AUDIO_FORMAT_F32_LE;
+        capture_rate = profile == CaptureProfile::Peaks ? kPeakSourceRate : profile_rate(profile);
+        capture_channels = profile_channels(profile);
+
+        pw_init(nullptr, nullptr);
+        loop = pw_thread_loop_new("visualizer-capture", nullptr);
+        context = pw_context_new(pw_thread_loop_get_loop(loop), nullptr, 0);
+        if (!context) return;
+        retry_timer = pw_loop_add_timer(pw_thread_loop_get_loop(loop), retry_cb, this);
+        // Only the first connection decides whether PipeWire is there at
+        // all; later ones retry until it is back.
+        open_core();
+    }
+
+    // Everything below runs on the loop thread (or before it starts).
+
+    bool open_core() {
+        core = pw_context_connect(context, nullptr, 0);
+        if (!core) return false;
+        std::memset(&core_events, 0, sizeof(core_events));
+        core_events.version = PW_VERSION_CORE_EVENTS;
+        core_events.error = on_core_error;
+        std::memset(&core_listener, 0, sizeof(core_listener));
+        pw_core_add_listener(core, &core_listener, &core_events, this);
+        open_stream();
+        return true;
+    }
+
+    void close_core() {
+        connected = false;
+        if (stream) {
+            spa_hook_remove(&stream_listener);
+            pw_stream_destroy(stream);
+            stream = nullptr;
+        }
+        if (core) {
+            spa_hook_remove(&core_listener);
+            pw_core_disconnect(core);
+            core = nullptr;
+        }
+    }
+
+    void open_stream() {
+        pw_properties* props = pw_properties_new(
+            PW_KEY_MEDIA_TYPE, "Audio",
+            PW_KEY_MEDIA_CATEGORY, "Capture",
+            PW_KEY_STREAM_CAPTURE_SINK, "true",
+            PW_KEY_NODE_NAME, "Visualizer",
+            nullptr);
+        // ~20 ms quanta, matching the fragment size asked of PulseAudio.
+        pw_properties_setf(props, PW_KEY_NODE_LATENCY, "%u/%u", capture_rate / 50, capture_rate);
+        stream = pw_stream_new(core, "Visualizer", props);
+
+        std::memset(&events, 0, sizeof(events));
+        events.version = PW_VERSION_STREAM_EVENTS;
+        events.state_changed = on_state_changed;
+        events.process = on_process;
+        std::memset(&stream_listener, 0, sizeof(stream_listener));
+        pw_stream_add_listener(stream, &stream_listener, &events, this);
+
+        spa_audio_info_raw info;
+        std::memset(&info, 0, sizeof(info));
+        info.format = format;
+        info.rate = capture_rate;
+        info.channels = capture_channels;
+
+        uint8_t buffer[1024];
+        spa_pod_builder b;
+        spa_pod_builder_init(&b, buffer, sizeof(buffer));
+        const spa_pod* params[1] = {spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat, &info)};
+
+        int flags = PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS | PW_STREAM_FLAG_RT_PROCESS;
+        if (get_activity() == Activity::Paused) flags |= PW_STREAM_FLAG_INACTIVE;
+        pw_stream_connect(stream, PW_DIRECTION_INPUT, PW_ID_ANY, (pw_stream_flags)flags, params, 1);
+    }
+
+    // Arms the retry timer for the next backoff step. The teardown happens
+    // there too, never inside the core or stream callback reporting the
+    // failure.
+    void schedule_reconnect() {
+        connected = false;
+        backoff_ms = backoff_ms ? std::min(backoff_ms * 2, kMaxBackoffMs) : kMinBackoffMs;
+        timespec value = {(time_t)(backoff_ms / 1000), (long)(backoff_ms % 1000) * 1000000L};
+        pw_loop_update_timer(pw_thread_loop_get_loop(loop), retry_timer, &value, nullptr, false);
+    }
+
+    static void retry_cb(void* data, uint64_t) {
+        auto* self = static_cast<PipeWireCapture*>(data);
+        ++self->reconnects;
+        self->close_core();
+        if (!self->open_core()) self->schedule_reconnect();
+    }
+
+    static void on_core_error(void* data, uint32_t id, int, int res, const char* message) {
+        auto* self = static_cast<PipeWireCapture*>(data);
+        // Errors on other objects are the stream's to report; a core error
+        // (EPIPE when the daemon exits) means the connection is gone.
+        if (id != PW_ID_CORE) return;
+        std::cerr << "PipeWire connection lost: " << (message ? message : spa_strerror(res)) << "\n";
+        self->schedule_reconnect();
+    }
+
+    static void on_state_changed(void* data, pw_stream_state old, pw_stream_state state, const char* error) {
+        auto* self = static_cast<PipeWireCapture*>(data);
+        self->connected = state == PW_STREAM_STATE_STREAMING;
+        if (state == PW_STREAM_STATE_STREAMING) self->backoff_ms = 0;
+        if (state == PW_STREAM_STATE_ERROR) {
+            std::cerr << "PipeWire capture error: " << (error ? error : "unknown") << "\n";
+            self->schedule_reconnect();
+        } else if (state == PW_STREAM_STATE_UNCONNECTED && old != PW_STREAM_STATE_UNCONNECTED) {
+            // Disconnected from the other side (our own teardown removes
+            // the listener first).
+            self->schedule_reconnect();
+        }
+    }
+
+    // Runs on the PipeWire data thread.
+    static void on_process(void* data) {
+        auto* self = static_cast<PipeWireCapture*>(data);
+        pw_buffer* b = pw_stream_dequeue_buffer(self->stream);
+        if (!b) {
+            self->read_errors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        spa_data& d = b->buffer->datas[0];
+        if (d.data && d.chunk) {
+            uint32_t offset = std::min(d.chunk->offset, d.maxsize);
+            uint32_t size = std::min(d.chunk->size, d.maxsize - offset);
+            const uint8_t* bytes = static_cast<const uint8_t*>(d.data) + offset;
+            if (d.chunk->flags & SPA_CHUNK_FLAG_CORRUPTED) {
+                self->holes.fetch_add(1, std::memory_order_relaxed);
+                self->hole_bytes.fetch_add(size, std::memory_order_relaxed);
+            } else if (self->format == SPA_AUDIO_FORMAT_S16_LE) {
+                self->deliver(reinterpret_cast<const int16_t*>(bytes), size / (2 * self->capture_channels));
+            } else if (self->profile == CaptureProfile::Peaks) {
+                // No server-side peak detection here: capture at the graph
+                // rate and fold every 1/kPeakRate s block ourselves.
+                self->deliver_peaks(reinterpret_cast<const float*>(bytes), size / sizeof(float),
+                                    self->capture_rate / kPeakRate);
+            } else {
+                self->deliver(reinterpret_cast<const float*>(bytes), size / (sizeof(float) * self->capture_channels));
+            }
+        }
+        pw_stream_queue_buffer(self->stream, b);
+
+        pw_time t;
+        if (pw_stream_get_time_n(self->stream, &t, sizeof(t)) == 0 && t.rate.denom) {
+            int64_t us = t.delay * 1000000 * (int64_t)t.rate.num / t.rate.denom;
+            us += (int64_t)t.buffered * 1000000 / self->capture_rate;
+            self->latency_us.store(us, std::memory_order_relaxed);
+        }
+    }
+};
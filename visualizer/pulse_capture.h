@@ -0,0 +1,390 @@
+#pragma once
+
+#include <pulse/pulseaudio.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#include "capture.h"
+
+// Captures the monitor of the output sink over libpulse (which also covers
+// PipeWire through pipewire-pulse). PulseAudio runs on its own
+// pa_threaded_mainloop thread, which sleeps in poll() until the server has
+// data for us, so an idle desktop costs no wakeups.
+//
+// It follows the server's default sink: when it changes, the record stream is
+// moved to the new monitor server-side, so the ring keeps flowing and the UI
+// never notices. If the server goes away (PulseAudio or PipeWire
+// restart) the context is rebuilt with exponential backoff; a record stream
+// that fails on a live context is reopened on the same backoff.
+//
+// Activity changes cork the record stream server-side. While Watching, a
+// second peak-detect stream on the same monitor sends one level per
+// fragment period instead, a few bytes at a time, and the first level above
+// silence uncorks the record stream again. The watcher is only opened the
+// first time capture goes Watching, so with idle pausing off it never
+// exists; after that it stays, corked while unused.
+class PulseCapture : public CaptureBackend {
+public:
+    enum class State { Connecting, Ready, Backoff };
+
+    explicit PulseCapture(CaptureProfile profile = CaptureProfile::Full)
+        : CaptureBackend(profile, profile_channels(profile), profile_rate(profile)),
+          spec(spec_for(profile)) {
+        mainloop = pa_threaded_mainloop_new();
+        api = pa_threaded_mainloop_get_api(mainloop);
+        connect_context();
+        pa_threaded_mainloop_start(mainloop);
+    }
+
+    ~PulseCapture() override {
+        // Tear the stream and context down under the loop lock so no callback
+        // can observe a half-destroyed capture, then stop the thread unlocked.
+        pa_threaded_mainloop_lock(mainloop);
+        if (retry_event) {
+            api->time_free(retry_event);
+            retry_event = nullptr;
+        }
+        close_stream();
+        close_context();
+        pa_threaded_mainloop_unlock(mainloop);
+        pa_threaded_mainloop_stop(mainloop);
+        pa_threaded_mainloop_free(mainloop);
+    }
+
+    const char* get_name() const override { return "pulse"; }
+    State get_state() const { return state; }
+
+protected:
+    void on_activity(Activity) override {
+        pa_threaded_mainloop_lock(mainloop);
+        apply_activity();
+        pa_threaded_mainloop_unlock(mainloop);
+    }
+
+private:
+    static constexpr unsigned kMinBackoffMs = 250;
+    static constexpr unsigned kMaxBackoffMs = 10000;
+    static constexpr unsigned kWatchRate = 50; // levels a second, one per 20 ms fragment
+
+    pa_threaded_mainloop* mainloop = nullptr;
+    pa_mainloop_api* api = nullptr;
+    pa_context* context = nullptr;
+    pa_stream* stream = nullptr;
+    pa_stream* watcher = nullptr; // peak-detect stream, uncorked only while Watching
+    bool watcher_failed = false;  // since the record stream was opened
+    pa_time_event* retry_event = nullptr;
+    pa_sample_spec spec;
+    std::atomic<State> state{State::Connecting};
+    std::string source_name; // monitor we record from, PA thread only
+    unsigned backoff_ms = 0;
+
+    // The server resamples (and, for Peaks, peak-detects) to the ring's format.
+    static pa_sample_spec spec_for(CaptureProfile profile) {
+        pa_sample_format_t format = profile == CaptureProfile::Compact ? PA_SAMPLE_S16LE : PA_SAMPLE_FLOAT32LE;
+        return {format, profile_rate(profile), (uint8_t)profile_channels(profile)};
+    }
+
+    // Everything below runs on the PulseAudio thread (or under its lock).
+
+    void connect_context() {
+        state = State::Connecting;
+        context = pa_context_new(api, "Visualizer");
+        pa_context_set_state_callback(context, context_cb, this);
+        pa_context_set_subscribe_callback(context, subscribe_cb, this);
+        // NOFAIL: wait for a server that is not up yet instead of failing.
+        if (pa_context_connect(context, nullptr, PA_CONTEXT_NOFAIL, nullptr) < 0) {
+            close_context();
+            schedule_reconnect();
+        }
+    }
+
+    void close_context() {
+        if (!context) return;
+        pa_context_set_state_callback(context, nullptr, nullptr);
+        pa_context_set_subscribe_callback(context, nullptr, nullptr);
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+        context = nullptr;
+    }
+
+    // Retries after the next backoff step: a fresh context when there is
+    // none, otherwise just the record stream.
+    void schedule_reconnect() {
+        state = State::Backoff;
+        if (retry_event) api->time_free(retry_event);
+        backoff_ms = backoff_ms ? std::min(backoff_ms * 2, kMaxBackoffMs) : kMinBackoffMs;
+        struct timeval tv;
+        pa_gettimeofday(&tv);
+        pa_timeval_add(&tv, (pa_usec_t)backoff_ms * PA_USEC_PER_MSEC);
+        retry_event = api->time_new(api, &tv, retry_cb, this);
+    }
+
+    static void retry_cb(pa_mainloop_api* a, pa_time_event* e, const struct timeval*, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        a->time_free(e);
+        self->retry_event = nullptr;
+        ++self->reconnects;
+        if (!self->context) {
+            self->connect_context();
+        } else if (pa_context_get_state(self->context) == PA_CONTEXT_READY) {
+            self->query_default_sink();
+        }
+    }
+
+    void open_stream() {
+        stream = pa_stream_new(context, "Stream", &spec, nullptr);
+        pa_stream_set_state_callback(stream, stream_state_cb, this);
+        pa_stream_set_moved_callback(stream, stream_moved_cb, this);
+        pa_stream_set_read_callback(stream, read_cb, this);
+        pa_stream_set_overflow_callback(stream, overflow_cb, this);
+
+        // ~20 ms fragments whatever the format, but never less than a frame.
+        uint32_t fragsize = (uint32_t)std::max(pa_frame_size(&spec),
+                                               pa_usec_to_bytes(20 * PA_USEC_PER_MSEC, &spec));
+        pa_buffer_attr attr = {(uint32_t)-1, (uint32_t)-1, (uint32_t)-1, (uint32_t)-1, fragsize};
+        // Timing updates keep pa_stream_get_latency() current for get_latency_us().
+        int flags = PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE;
+        if (profile == CaptureProfile::Peaks) flags |= PA_STREAM_PEAK_DETECT;
+        if (get_activity() != Activity::Capturing) flags |= PA_STREAM_START_CORKED;
+        pa_stream_connect_record(stream, source_name.c_str(), &attr, (pa_stream_flags_t)flags);
+        watcher_failed = false;
+        if (get_activity() == Activity::Watching) open_watcher();
+    }
+
+    void open_watcher() {
+        pa_sample_spec ws = {PA_SAMPLE_FLOAT32LE, kWatchRate, 1};
+        watcher = pa_stream_new(context, "Watcher", &ws, nullptr);
+        pa_stream_set_state_callback(watcher, watcher_state_cb, this);
+        pa_stream_set_read_callback(watcher, watch_cb, this);
+        pa_buffer_attr attr = {(uint32_t)-1, (uint32_t)-1, (uint32_t)-1, (uint32_t)-1, (uint32_t)sizeof(float)};
+        int flags = PA_STREAM_PEAK_DETECT | PA_STREAM_ADJUST_LATENCY;
+        if (get_activity() != Activity::Watching) flags |= PA_STREAM_START_CORKED;
+        pa_stream_connect_record(watcher, source_name.c_str(), &attr, (pa_stream_flags_t)flags);
+    }
+
+    void close_watcher() {
+        if (!watcher) return;
+        pa_stream_set_state_callback(watcher, nullptr, nullptr);
+        pa_stream_set_read_callback(watcher, nullptr, nullptr);
+        pa_stream_disconnect(watcher);
+        pa_stream_unref(watcher);
+        watcher = nullptr;
+    }
+
+    static bool is_ready(pa_stream* s) { return s && pa_stream_get_state(s) == PA_STREAM_READY; }
+
+    static void cork(pa_stream* s, bool corked) {
+        pa_operation* op = pa_stream_cork(s, corked, nullptr, nullptr);
+        if (op) pa_operation_unref(op);
+    }
+
+    // Corks whatever the activity says should be quiet. Streams that are not
+    // ready yet were connected corked or not to match, and get this again
+    // once they are. Without a working watcher, Watching keeps the record
+    // stream running and deliver() listens instead.
+    void apply_activity() {
+        Activity a = get_activity();
+        if (a == Activity::Watching && !watcher && !watcher_failed && stream) open_watcher();
+        bool watching = a == Activity::Watching && is_ready(watcher);
+        if (is_ready(stream)) cork(stream, a == Activity::Paused || watching);
+        if (is_ready(watcher)) cork(watcher, !watching);
+    }
+
+    void close_stream() {
+        connected = false;
+        close_watcher();
+        if (!stream) return;
+        pa_stream_set_state_callback(stream, nullptr, nullptr);
+        pa_stream_set_moved_callback(stream, nullptr, nullptr);
+        pa_stream_set_read_callback(stream, nullptr, nullptr);
+        pa_stream_set_overflow_callback(stream, nullptr, nullptr);
+        pa_stream_disconnect(stream);
+        pa_stream_unref(stream);
+        stream = nullptr;
+    }
+
+    void query_default_sink() {
+        pa_operation* op = pa_context_get_server_info(context, server_info_cb, this);
+        if (op) pa_operation_unref(op);
+    }
+
+    static void context_cb(pa_context* c, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY: {
+            // The backoff resets once the record stream is up, so a server
+            // that accepts us but keeps failing the stream still backs off.
+            self->state = State::Ready;
+            pa_operation* op = pa_context_subscribe(c, PA_SUBSCRIPTION_MASK_SERVER, nullptr, nullptr);
+            if (op) pa_operation_unref(op);
+            self->query_default_sink();
+            break;
+        }
+        case PA_CONTEXT_FAILED:
+        case PA_CONTEXT_TERMINATED:
+            // The server went away; start over from a fresh context.
+            self->close_stream();
+            self->close_context();
+            self->schedule_reconnect();
+            break;
+        default:
+            break;
+        }
+    }
+
+    static void subscribe_cb(pa_context*, pa_subscription_event_type_t t, uint32_t, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        // Default sink changes arrive as server change events.
+        if ((t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) == PA_SUBSCRIPTION_EVENT_SERVER) {
+            self->query_default_sink();
+        }
+    }
+
+    static void server_info_cb(pa_context* c, const pa_server_info* info, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        if (!info || !info->default_sink_name) return;
+
+        // Server change events come for more than the default sink; with the
+        // same monitor there is nothing to move or reopen.
+        std::string monitor = std::string(info->default_sink_name) + ".monitor";
+        if (self->stream && monitor == self->source_name) return;
+        self->source_name = monitor;
+
+        if (!self->stream) {
+            self->open_stream();
+            return;
+        }
+        pa_operation* op = pa_context_move_source_output_by_name(
+            c, pa_stream_get_index(self->stream), monitor.c_str(), move_cb, self);
+        if (op) pa_operation_unref(op);
+        self->reopen_watcher();
+    }
+
+    // A watcher that exists follows the record stream to its new monitor.
+    void reopen_watcher() {
+        if (!watcher) return;
+        close_watcher();
+        open_watcher();
+    }
+
+    static void move_cb(pa_context*, int success, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        if (success) {
+            ++self->moves;
+            return;
+        }
+        // The server refused the move; reopen on the new monitor instead.
+        self->close_stream();
+        self->open_stream();
+    }
+
+    static void stream_state_cb(pa_stream* s, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        switch (pa_stream_get_state(s)) {
+        case PA_STREAM_READY:
+            self->connected = true;
+            self->state = State::Ready;
+            self->backoff_ms = 0;
+            self->apply_activity();
+            break;
+        case PA_STREAM_FAILED:
+        case PA_STREAM_TERMINATED:
+            // E.g. the monitor source vanished. Unless the whole context is
+            // going down, reattach to whatever the default sink is then,
+            // backing off so a monitor that keeps failing is not hammered.
+            self->close_stream();
+            self->source_name.clear();
+            if (self->context && pa_context_get_state(self->context) == PA_CONTEXT_READY) {
+                self->schedule_reconnect();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    static void watcher_state_cb(pa_stream* s, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        switch (pa_stream_get_state(s)) {
+        case PA_STREAM_READY:
+            self->apply_activity();
+            break;
+        case PA_STREAM_FAILED:
+        case PA_STREAM_TERMINATED:
+            // Fall back to listening on the record stream until the stream
+            // is reopened, rather than retrying the watcher in a loop.
+            self->watcher_failed = true;
+            self->close_watcher();
+            self->apply_activity();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Any level above silence ends Watching. Levels are only drained here;
+    // the ring never sees them.
+    static void watch_cb(pa_stream* s, size_t, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        bool sound = false;
+        const void* buffer;
+        size_t size;
+        while (pa_stream_peek(s, &buffer, &size) == 0 && size > 0) {
+            const float* levels = static_cast<const float*>(buffer);
+            for (size_t i = 0; buffer && i < size / sizeof(float); ++i) sound |= levels[i] > kSilence;
+            pa_stream_drop(s);
+        }
+        if (sound && self->wake()) self->apply_activity();
+    }
+
+    static void stream_moved_cb(pa_stream* s, void* data) {
+        // The server moved us on its own (e.g. the sink was unplugged).
+        auto* self = static_cast<PulseCapture*>(data);
+        const char* name = pa_stream_get_device_name(s);
+        if (!name || self->source_name == name) return;
+        self->source_name = name;
+        self->reopen_watcher();
+    }
+
+    static void overflow_cb(pa_stream*, void* data) {
+        static_cast<PulseCapture*>(data)->server_overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drains everything readable in one go. A null buffer with a non-zero
+    // size is a hole: it still has to be dropped or the stream stalls on it.
+    static void read_cb(pa_stream* s, size_t, void* data) {
+        auto* self = static_cast<PulseCapture*>(data);
+        size_t frame_size = pa_frame_size(&self->spec);
+
+        for (;;) {
+            size_t readable = pa_stream_readable_size(s);
+            if (readable == 0 || readable == (size_t)-1) break;
+
+            const void* buffer;
+            size_t size;
+            if (pa_stream_peek(s, &buffer, &size) < 0) {
+                self->read_errors.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            if (size == 0) break; // nothing queued after all; nothing to drop
+
+            if (!buffer) {
+                self->holes.fetch_add(1, std::memory_order_relaxed);
+                self->hole_bytes.fetch_add(size, std::memory_order_relaxed);
+            } else if (self->spec.format == PA_SAMPLE_S16LE) {
+                self->deliver(static_cast<const int16_t*>(buffer), size / frame_size);
+            } else {
+                self->deliver(static_cast<const float*>(buffer), size / frame_size);
+            }
+            pa_stream_drop(s);
+        }
+
+        pa_usec_t latency;
+        int negative;
+        if (pa_stream_get_latency(s, &latency, &negative) == 0) {
+            self->latency_us.store(negative ? -(int64_t)latency : (int64_t)latency, std::memory_order_relaxed);
+        }
+    }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Bars radiating around a circle, first bar at twelve o'clock and going
+// clockwise. Each bar is a rectangle rotated onto its spoke: its inner edge
+// sits on the inner circle and it grows outwards with its level. layout()
+// runs the trigonometry once per allocation, storing every bar's direction
+// and inner corners (structure of arrays); after that a frame's quad is the
+// inner corners pushed out along the direction, a multiply-add per corner
+// with no trig at all.
+class RadialLayout {
+public:
+    // Corners in drawing order: inner two, then outer two.
+    struct Quad {
+        float x[4], y[4];
+    };
+
+    static constexpr float kInnerFraction = 0.35f; // inner radius, of the outer
+    static constexpr float kFill = 0.7f;           // bar width, of its angular share
+
+    void layout(int bar_count, int width, int height) {
+        center_x = width * 0.5f;
+        center_y = height * 0.5f;
+        outer = std::max(1.0f, std::min(width, height) * 0.5f - 2.0f);
+        inner = outer * kInnerFraction;
+        half_width = (float)M_PI * inner / std::max(1, bar_count) * kFill;
+
+        dx.resize(bar_count);
+        dy.resize(bar_count);
+        ax.resize(bar_count);
+        ay.resize(bar_count);
+        bx.resize(bar_count);
+        by.resize(bar_count);
+        for (int i = 0; i < bar_count; ++i) {
+            double angle = -M_PI / 2 + 2 * M_PI * (i + 0.5) / bar_count;
+            dx[i] = (float)std::cos(angle);
+            dy[i] = (float)std::sin(angle);
+            float base_x = center_x + dx[i] * inner, base_y = center_y + dy[i] * inner;
+            ax[i] = base_x - dy[i] * half_width;
+            ay[i] = base_y + dx[i] * half_width;
+            bx[i] = base_x + dy[i] * half_width;
+            by[i] = base_y - dx[i] * half_width;
+        }
+    }
+
+    // Bar i at level 0..1 of the ring between the two circles.
+    Quad quad(int i, float level) const {
+        float length = level * (outer - inner);
+        float ox = dx[i] * length, oy = dy[i] * length;
+        return {{ax[i], bx[i], bx[i] + ox, ax[i] + ox}, {ay[i], by[i], by[i] + oy, ay[i] + oy}};
+    }
+
+    float get_center_x() const { return center_x; }
+    float get_center_y() const { return center_y; }
+    float get_inner() const { return inner; }
+
+private:
+    float center_x = 0.0f, center_y = 0.0f;
+    float inner = 0.0f, outer = 1.0f, half_width = 0.0f;
+    std::vector<float> dx, dy; // unit direction of each spoke
+    std::vector<float> ax, ay; // inner corners, clockwise side
+    std::vector<float> bx, by; // and counter-clockwise side
+};
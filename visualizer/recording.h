@@ -0,0 +1,270 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+
+// Capture recordings: every fragment a backend delivered, with its arrival
+// time, exactly as it went into the ring. Replaying one reproduces both the
+// audio and the fragment pattern (bursts, stalls) of the original session.
+//
+// The file is a FileHeader followed by fragments, each a FragmentHeader and
+// its interleaved samples padded to 8 bytes. Everything is fixed-size,
+// naturally aligned and little-endian, so a reader maps the file and walks it
+// in place. A truncated tail (e.g. the visualizer was killed) just ends the
+// recording at the last whole fragment.
+namespace recording {
+
+constexpr char kMagic[8] = {'E', 'L', 'Y', 'C', 'A', 'P', '\0', '\0'};
+constexpr uint32_t kVersion = 1;
+
+enum Format : uint32_t { F32 = 0, S16 = 1 };
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t profile;  // CaptureProfile the session ran with
+    uint32_t rate;     // frames per second in the ring
+    uint32_t channels; // interleaved channels per frame
+    int64_t start_ns;  // steady clock at the start, for reference only
+};
+
+struct FragmentHeader {
+    int64_t offset_ns; // arrival time relative to FileHeader::start_ns
+    uint32_t frames;
+    uint32_t format;   // Format of the samples that follow
+};
+
+static_assert(sizeof(FileHeader) == 32 && sizeof(FragmentHeader) == 16, "recording layout changed");
+
+template <typename Sample> constexpr uint32_t format_of();
+template <> constexpr uint32_t format_of<float>() { return F32; }
+template <> constexpr uint32_t format_of<int16_t>() { return S16; }
+
+inline size_t sample_size(uint32_t format) { return format == S16 ? sizeof(int16_t) : sizeof(float); }
+inline size_t padded(size_t bytes) { return (bytes + 7) & ~(size_t)7; }
+
+} // namespace recording
+
+// Appends fragments to a recording. write() runs on the capture thread, which
+// for PipeWire is the realtime graph thread, so it never touches the file: it
+// copies the fragment into a byte ring and returns. A writer thread drains
+// the ring to the file every kFlushMs, so a killed process loses at most that
+// much of the tail, and once more when the recorder is destroyed. A fragment
+// that finds the ring full is dropped whole and counted; the recording then
+// has a gap but stays well-formed.
+class CaptureRecorder {
+public:
+    // Returns nullptr (after saying why) when path can't be created.
+    static std::unique_ptr<CaptureRecorder> create(const std::string& path, CaptureProfile profile,
+                                                   unsigned rate, unsigned channels, int64_t start_ns) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "Cannot record to " << path << ": " << std::strerror(errno) << "\n";
+            return nullptr;
+        }
+        recording::FileHeader header = {};
+        std::memcpy(header.magic, recording::kMagic, sizeof(header.magic));
+        header.version = recording::kVersion;
+        header.profile = (uint32_t)profile;
+        header.rate = rate;
+        header.channels = channels;
+        header.start_ns = start_ns;
+        return std::unique_ptr<CaptureRecorder>(new CaptureRecorder(fd, header));
+    }
+
+    ~CaptureRecorder() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_one();
+        writer.join();
+        ::close(fd);
+        uint64_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost) std::cerr << "Recording dropped " << lost << " fragments, the disk fell behind\n";
+    }
+
+    CaptureRecorder(const CaptureRecorder&) = delete;
+    CaptureRecorder& operator=(const CaptureRecorder&) = delete;
+
+    // Capture thread only: no locks, no syscalls.
+    template <typename Sample>
+    void write(const Sample* frames, size_t count, int64_t arrival_ns) {
+        static const char kZeros[8] = {};
+        size_t bytes = count * channels * sizeof(Sample);
+        recording::FragmentHeader header = {arrival_ns - start_ns, (uint32_t)count,
+                                            recording::format_of<Sample>()};
+        size_t head = this->head.load(std::memory_order_relaxed);
+        size_t tail = this->tail.load(std::memory_order_acquire);
+        if (kRingBytes - (head - tail) < sizeof(header) + recording::padded(bytes)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        head = put(head, &header, sizeof(header));
+        head = put(head, frames, bytes);
+        head = put(head, kZeros, recording::padded(bytes) - bytes);
+        this->head.store(head, std::memory_order_release);
+    }
+
+    uint64_t get_dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t kRingBytes = 4 << 20; // ~12 s of Full capture
+    static constexpr int kFlushMs = 250;
+
+    int fd;
+    unsigned channels;
+    int64_t start_ns;
+    std::vector<char> ring;
+    std::atomic<size_t> head{0}; // bytes ever written by write()
+    std::atomic<size_t> tail{0}; // bytes ever handed to the file
+    std::atomic<uint64_t> dropped{0};
+    bool failed = false; // writer thread only
+    std::mutex mutex;    // guards stopping, between the writer and the destructor
+    std::condition_variable wakeup;
+    bool stopping = false;
+    std::thread writer;
+
+    CaptureRecorder(int fd, const recording::FileHeader& header)
+        : fd(fd), channels(header.channels), start_ns(header.start_ns), ring(kRingBytes) {
+        write_all(&header, sizeof(header));
+        writer = std::thread([this] { run(); });
+    }
+
+    size_t put(size_t head, const void* src, size_t n) {
+        size_t at = head % kRingBytes, first = std::min(n, kRingBytes - at);
+        std::memcpy(ring.data() + at, src, first);
+        std::memcpy(ring.data(), static_cast<const char*>(src) + first, n - first);
+        return head + n;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wakeup.wait_for(lock, std::chrono::milliseconds(kFlushMs));
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+
+    void drain() {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        size_t head = this->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            size_t at = tail % kRingBytes, n = std::min(head - tail, kRingBytes - at);
+            write_all(ring.data() + at, n);
+            tail += n;
+        }
+        this->tail.store(tail, std::memory_order_release);
+    }
+
+    // Straight to the kernel, so what is written survives the process. After
+    // an error the rest of the session is discarded rather than retried.
+    void write_all(const void* data, size_t n) {
+        const char* p = static_cast<const char*>(data);
+        while (n > 0 && !failed) {
+            ssize_t w = ::write(fd, p, n);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) {
+                std::cerr << "Recording stopped: " << std::strerror(errno) << "\n";
+                failed = true;
+                break;
+            }
+            p += w;
+            n -= (size_t)w;
+        }
+    }
+};
+
+// A recording mapped read-only. Walk it with next(); fragment data points
+// straight into the mapping and stays valid as long as the Recording.
+class Recording {
+public:
+    struct Fragment {
+        int64_t offset_ns;
+        uint32_t frames;
+        uint32_t format;
+        const void* samples;
+    };
+
+    // Returns nullptr (after saying why) when path is missing or not a
+    // recording this build understands.
+    static std::unique_ptr<Recording> open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Cannot open recording " << path << ": " << std::strerror(errno) << "\n";
+            return nullptr;
+        }
+        struct stat st;
+        void* map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(recording::FileHeader)) {
+            map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            std::cerr << path << ": not a capture recording\n";
+            return nullptr;
+        }
+        std::unique_ptr<Recording> rec(new Recording(static_cast<const char*>(map), st.st_size));
+        const recording::FileHeader& h = rec->header();
+        if (std::memcmp(h.magic, recording::kMagic, sizeof(h.magic)) != 0 || h.version != recording::kVersion
+            || h.rate == 0 || h.channels == 0 || h.profile > (uint32_t)CaptureProfile::Peaks) {
+            std::cerr << path << ": not a version " << recording::kVersion << " capture recording\n";
+            return nullptr;
+        }
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+        return rec;
+    }
+
+    ~Recording() { munmap(const_cast<char*>(data), size); }
+
+    Recording(const Recording&) = delete;
+    Recording& operator=(const Recording&) = delete;
+
+    const recording::FileHeader& header() const {
+        return *reinterpret_cast<const recording::FileHeader*>(data);
+    }
+    CaptureProfile get_profile() const { return (CaptureProfile)header().profile; }
+    unsigned get_rate() const { return header().rate; }
+    unsigned get_channels() const { return header().channels; }
+
+    // Cursor for next(), positioned at the first fragment.
+    static constexpr size_t begin() { return sizeof(recording::FileHeader); }
+
+    // Reads the fragment at pos and advances pos past it. Returns false at
+    // the end, including on a truncated last fragment.
+    bool next(size_t& pos, Fragment& out) const {
+        if (size - pos < sizeof(recording::FragmentHeader)) return false;
+        recording::FragmentHeader h;
+        std::memcpy(&h, data + pos, sizeof(h));
+        size_t bytes = recording::padded((size_t)h.frames * get_channels() * recording::sample_size(h.format));
+        if (size - pos - sizeof(h) < bytes) return false;
+        out = {h.offset_ns, h.frames, h.format, data + pos + sizeof(h)};
+        pos += sizeof(h) + bytes;
+        return true;
+    }
+
+private:
+    const char* data;
+    size_t size;
+
+    Recording(const char* data, size_t size) : data(data), size(size) {}
+};
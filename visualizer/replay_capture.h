@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "capture.h"
+#include "recording.h"
+
+// Plays a capture recording back into the ring on its own thread, once.
+// Paced, every fragment is delivered at its recorded arrival time, so bursts
+// and stalls land on the UI as they did originally; fast, fragments go in
+// whenever the ring has room for them, so the consumer sets the speed and
+// nothing is dropped. The ring has the recorded profile, rate and channels
+// whatever the current settings say.
+class ReplayCapture : public CaptureBackend {
+public:
+    // Returns nullptr when path is not a usable recording.
+    static std::unique_ptr<ReplayCapture> create(const std::string& path, bool paced) {
+        std::unique_ptr<Recording> recording = Recording::open(path);
+        if (!recording) return nullptr;
+        return std::unique_ptr<ReplayCapture>(new ReplayCapture(std::move(recording), paced));
+    }
+
+    ~ReplayCapture() override {
+        running = false;
+        worker.join();
+    }
+
+    const char* get_name() const override { return "replay"; }
+
+private:
+    std::unique_ptr<Recording> recording;
+    bool paced;
+    std::atomic<bool> running{true};
+    std::thread worker;
+
+    ReplayCapture(std::unique_ptr<Recording> rec, bool paced)
+        : CaptureBackend(rec->get_profile(), rec->get_channels(), rec->get_rate()),
+          recording(std::move(rec)), paced(paced) {
+        connected = true;
+        worker = std::thread([this] { run(); });
+    }
+
+    void run() {
+        using clock = std::chrono::steady_clock;
+        const auto start = clock::now();
+        Recording::Fragment f;
+        for (size_t pos = Recording::begin(); running && recording->next(pos, f);) {
+            if (paced) {
+                // Sleep in short steps so shutdown never waits on a long gap.
+                auto due = start + std::chrono::nanoseconds(f.offset_ns);
+                while (running && clock::now() < due) {
+                    std::this_thread::sleep_until(std::min(due, clock::now() + std::chrono::milliseconds(50)));
+                }
+            } else {
+                size_t need = std::min<size_t>(f.frames, ring.get_capacity());
+                while (running && ring.get_capacity() - ring.available() < need) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+            if (f.format == recording::S16) {
+                deliver(static_cast<const int16_t*>(f.samples), f.frames);
+            } else {
+                deliver(static_cast<const float*>(f.samples), f.frames);
+            }
+        }
+        connected = false;
+    }
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Monotonic clock used for every capture/render timestamp in the visualizer.
+inline int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Lock-free single-producer/single-consumer ring of interleaved float frames.
+// The capture thread pushes whole fragments, the GTK thread pulls windows of
+// any size. Every frame carries the steady-clock time (ns) it was captured at.
+//
+// When the ring is full the producer drops the tail of the fragment instead of
+// blocking (an overrun); when the consumer finds it empty that is an underrun.
+// Both are counted so the capacity can be sized from real numbers.
+class SampleRing {
+public:
+    struct Stats {
+        uint64_t overruns;
+        uint64_t dropped_frames;
+        uint64_t underruns;
+    };
+
+    SampleRing(unsigned channels, unsigned rate, size_t min_frames)
+        : channels(channels), frame_ns(1000000000.0 / rate) {
+        capacity = 1;
+        while (capacity < min_frames) capacity <<= 1;
+        mask = capacity - 1;
+        data.assign(capacity * channels, 0.0f);
+        stamps.assign(capacity, 0);
+    }
+
+    SampleRing(const SampleRing&) = delete;
+    SampleRing& operator=(const SampleRing&) = delete;
+
+    unsigned get_channels() const { return channels; }
+    size_t get_capacity() const { return capacity; }
+
+    // Producer side. stamp_ns is the capture time of the first frame.
+    size_t push(const float* frames, size_t count, int64_t stamp_ns) {
+        uint64_t w = head.load(std::memory_order_relaxed);
+        uint64_t r = tail.load(std::memory_order_acquire);
+        size_t room = capacity - (size_t)(w - r);
+        size_t n = std::min(count, room);
+        if (n < count) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            dropped.fetch_add(count - n, std::memory_order_relaxed);
+        }
+
+        size_t pos = (size_t)(w & mask);
+        size_t first = std::min(n, capacity - pos);
+        std::memcpy(&data[pos * channels], frames, first * channels * sizeof(float));
+        std::memcpy(&data[0], frames + first * channels, (n - first) * channels * sizeof(float));
+        for (size_t i = 0; i < n; ++i) {
+            stamps[(w + i) & mask] = stamp_ns + (int64_t)(i * frame_ns);
+        }
+
+        head.store(w + n, std::memory_order_release);
+        return n;
+    }
+
+    // Same, for signed 16-bit input; samples are converted to float on the way
+    // into the ring so the consumer only ever sees one format.
+    size_t push(const int16_t* frames, size_t count, int64_t stamp_ns) {
+        uint64_t w = head.load(std::memory_order_relaxed);
+        uint64_t r = tail.load(std::memory_order_acquire);
+        size_t room = capacity - (size_t)(w - r);
+        size_t n = std::min(count, room);
+        if (n < count) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            dropped.fetch_add(count - n, std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            size_t pos = (size_t)((w + i) & mask);
+            for (unsigned c = 0; c < channels; ++c) {
+                data[pos * channels + c] = frames[i * channels + c] * (1.0f / 32768.0f);
+            }
+            stamps[pos] = stamp_ns + (int64_t)(i * frame_ns);
+        }
+
+        head.store(w + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side.
+    size_t available() const {
+        return (size_t)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed));
+    }
+
+    // Copies up to max_frames into dst and returns how many were copied.
+    // stamp_ns (optional) receives the capture time of the first one.
+    size_t read(float* dst, size_t max_frames, int64_t* stamp_ns = nullptr) {
+        uint64_t r = tail.load(std::memory_order_relaxed);
+        size_t n = std::min(max_frames, (size_t)(head.load(std::memory_order_acquire) - r));
+        if (n == 0) {
+            underruns.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+
+        size_t pos = (size_t)(r & mask);
+        size_t first = std::min(n, capacity - pos);
+        std::memcpy(dst, &data[pos * channels], first * channels * sizeof(float));
+        std::memcpy(dst + first * channels, &data[0], (n - first) * channels * sizeof(float));
+        if (stamp_ns) *stamp_ns = stamps[pos];
+
+        tail.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    // Counts an underrun the consumer found without calling read(), e.g.
+    // when it checks available() first.
+    void note_underrun() { underruns.fetch_add(1, std::memory_order_relaxed); }
+
+    // Discards frames without copying them, e.g. to catch up after a stall.
+    size_t skip(size_t frames) {
+        uint64_t r = tail.load(std::memory_order_relaxed);
+        size_t n = std::min(frames, (size_t)(head.load(std::memory_order_acquire) - r));
+        tail.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    Stats get_stats() const {
+        return {overruns.load(std::memory_order_relaxed),
+                dropped.load(std::memory_order_relaxed),
+                underruns.load(std::memory_order_relaxed)};
+    }
+
+private:
+    unsigned channels;
+    double frame_ns;
+    size_t capacity;
+    size_t mask;
+    std::vector<float> data;
+    std::vector<int64_t> stamps;
+
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    alignas(64) std::atomic<uint64_t> overruns{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> underruns{0};
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kernels.h"
+#include "palette.h"
+
+// Oscilloscope of the captured waveform in a pixel buffer (ARGB32, like
+// BarRaster). Every pixel column is the min/max of the frames that land in
+// it, drawn as one vertical span, so dense audio reads as a solid band
+// instead of aliasing into a thin line. The min/max is the vectorized kernel
+// and each column only rewrites the rows where its old and new spans differ.
+//
+// The window is the audio one display frame brings in, capped at kMaxFrames,
+// so nothing between two frames goes unseen and the timebase is the same at
+// any width. A column may then hold only a frame or two (a 4K scope at 60 Hz
+// has about 0.2 frames of 44.1 kHz audio per column); it still takes the
+// first frame of the next, so the trace stays connected.
+//
+// The window starts at the newest rising crossing of the trigger level in
+// the kSearch frames before it, which holds a periodic wave still from one
+// frame to the next. Without a crossing (silence, noise) it free-runs on the
+// newest audio.
+class Scope {
+public:
+    static constexpr size_t kMaxFrames = 32768; // widest window
+    static constexpr size_t kSearch = 2048;     // looked back through for the trigger
+    static constexpr size_t kMaxHistory = kMaxFrames + kSearch;
+
+    explicit Scope(const Palette& palette, float trigger_level = 0.0f)
+        : color(palette.fill(Palette::kSize - 1)), level(trigger_level), kernels(kernels::best()) {}
+
+    // Device pixels, and the frames one display frame brings in. Sizes the
+    // window, precomputes the first frame of every column and forgets what
+    // was drawn: pair it with a fresh, transparent buffer.
+    void layout(int width, int height, size_t frames_per_draw) {
+        this->height = std::max(1, height);
+        window = std::clamp(frames_per_draw, (size_t)1, kMaxFrames);
+        column_start.resize(width + 1);
+        for (int c = 0; c <= width; ++c) column_start[c] = (size_t)((uint64_t)c * window / std::max(1, width));
+        lo.resize(width);
+        hi.resize(width);
+        drawn_top.assign(width, 0);
+        drawn_bottom.assign(width, 0);
+    }
+
+    // Frames draw() wants in its history: the window plus the trigger search.
+    size_t get_history() const { return window + kSearch; }
+    size_t get_window() const { return window; }
+
+    // Offset into history (get_history() mono frames, oldest first) where
+    // the window starts: just after the newest rising crossing of level, or
+    // kSearch (the newest window) when there is none.
+    static size_t trigger(const float* history, float level) {
+        for (size_t i = kSearch; i > 0; --i) {
+            if (history[i - 1] < level && history[i] >= level) return i;
+        }
+        return kSearch;
+    }
+
+    // Shows the window of history after the trigger (stride in bytes).
+    // Returns whether anything was written.
+    bool draw(uint8_t* pixels, int stride, const float* history) {
+        size_t start = trigger(history, level);
+        triggered += start != kSearch;
+        ++frames;
+        decimate(history + start);
+
+        bool dirty = false;
+        for (size_t c = 0; c < lo.size(); ++c) {
+            int top = row_of(hi[c]), bottom = row_of(lo[c]) + 1;
+            int old_top = drawn_top[c], old_bottom = drawn_bottom[c];
+            if (top == old_top && bottom == old_bottom) continue;
+            uint8_t* column = pixels + c * sizeof(uint32_t);
+            for (int y = std::min(top, old_top), end = std::max(bottom, old_bottom); y < end; ++y) {
+                bool now = y >= top && y < bottom, was = y >= old_top && y < old_bottom;
+                if (now != was) *reinterpret_cast<uint32_t*>(column + (size_t)y * stride) = now ? color : 0;
+            }
+            drawn_top[c] = top;
+            drawn_bottom[c] = bottom;
+            dirty = true;
+        }
+        return dirty;
+    }
+
+    // Frames drawn, and how many of them found a trigger.
+    uint64_t get_frames() const { return frames; }
+    uint64_t get_triggered() const { return triggered; }
+
+private:
+    uint32_t color;
+    float level;
+    size_t window = 1; // frames across the width
+    const kernels::Set& kernels;
+    int height = 1;
+    std::vector<size_t> column_start; // first window frame of each column, plus window
+    std::vector<float> lo, hi;        // per column, from the last decimate()
+    std::vector<int> drawn_top;       // rows the buffer holds, [top, bottom)
+    std::vector<int> drawn_bottom;
+    uint64_t frames = 0, triggered = 0;
+
+    // Min/max per column. Each column also takes the first frame of the
+    // next, so neighbouring spans meet into a connected trace.
+    void decimate(const float* samples) {
+        for (size_t c = 0; c < lo.size(); ++c) {
+            size_t a = column_start[c];
+            size_t b = std::min(window, std::max(column_start[c + 1], a + 1) + 1);
+            kernels.min_max(samples + a, b - a, &lo[c], &hi[c]);
+        }
+    }
+
+    int row_of(float v) const {
+        return std::clamp((int)((0.5f - 0.5f * v) * height), 0, height - 1);
+    }
+};
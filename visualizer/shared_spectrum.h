@@ -0,0 +1,311 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "analysis.h"
+#include "sample_ring.h"
+
+// Analysis results shared between processes, so one capture can feed any
+// number of renderers. The publisher (a visualizer with share = publish)
+// writes the segment after every analysis update; subscribers map it
+// read-only and copy a snapshot out each tick. There are no locks and, once
+// mapped, no syscalls on either side.
+//
+// Consistency is a seqlock: the writer makes seq odd, writes, then makes it
+// even again. A reader copies between two reads of seq and retries if either
+// was odd or they differ. The segment lives in /dev/shm, one per user.
+//
+// Only one publisher may write it. Ownership is an exclusive flock on the
+// segment, held for the publisher's lifetime and released by the kernel if
+// it dies; the owner unlinks the segment only while still holding it, so an
+// exiting publisher can never delete a successor's segment.
+//
+// A publisher that pauses on silence stops publishing, so it marks the
+// segment idle first. Subscribers treat an idle segment as live rather than
+// stale and wait for it to wake instead of looking for a new one, for as long
+// as the owner's flock is still held: a publisher killed while idle leaves
+// the segment idle, but not locked.
+namespace shared_spectrum {
+
+constexpr char kMagic[8] = {'E', 'L', 'Y', 'S', 'P', 'E', 'C', '\0'};
+constexpr uint32_t kVersion = 2;
+constexpr size_t kMaxBars = 512; // VisualizerConfig caps bars here too
+
+struct Segment {
+    char magic[8];
+    uint32_t version;
+    uint32_t size; // sizeof(Segment), guards against layout mismatches
+    std::atomic<uint32_t> seq;
+    uint32_t bar_count;
+    int64_t published_ns; // steady clock (CLOCK_MONOTONIC, shared by every process)
+    int64_t audio_ns;     // arrival of the newest audio behind these bars
+    uint32_t connected;   // publisher's capture is live
+    uint32_t idle;        // publisher paused; published_ns stays put until it resumes
+    float peak;
+    float momentary_lufs;
+    float short_term_lufs;
+    float gain_db;
+    float bpm;
+    uint64_t beats;       // beats detected so far; a change is a beat
+    float bars[kMaxBars]; // 0..1 per bar
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock needs a lock-free counter");
+
+// What a subscriber reads out of the segment.
+struct Snapshot {
+    std::vector<float> bars;
+    int64_t published_ns = 0;
+    int64_t audio_ns = 0;
+    bool connected = false;
+    bool idle = false;
+    float peak = 0.0f;
+    float momentary_lufs = 0.0f;
+    float short_term_lufs = 0.0f;
+    float gain_db = 0.0f;
+    float bpm = 0.0f;
+    uint64_t beats = 0;
+};
+
+// Data older than this means the publisher is gone or stuck.
+constexpr int64_t kStaleNs = 1000000000;
+
+inline std::string segment_name() {
+    return "/elysia-visualizer-" + std::to_string(getuid());
+}
+
+} // namespace shared_spectrum
+
+class SpectrumPublisher {
+public:
+    // Returns nullptr (after saying why) when the segment can't be created
+    // or another publisher owns it.
+    static std::unique_ptr<SpectrumPublisher> create() {
+        std::string name = shared_spectrum::segment_name();
+        int fd = -1;
+        // The owner may unlink the name between our open and our lock, which
+        // would leave us owning an orphan; check the lock is on the object the
+        // name still refers to, and go again if not.
+        for (int attempt = 0; attempt < kMaxAttempts && fd < 0; ++attempt) {
+            fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+            if (fd < 0) break;
+            if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+                if (errno == EWOULDBLOCK) std::cerr << "Another visualizer is already publishing its spectrum\n";
+                else std::cerr << "Cannot lock " << name << ": " << std::strerror(errno) << "\n";
+                close(fd);
+                return nullptr;
+            }
+            if (!names_object(name, fd)) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        void* map = MAP_FAILED;
+        if (fd >= 0 && ftruncate(fd, sizeof(shared_spectrum::Segment)) == 0) {
+            map = mmap(nullptr, sizeof(shared_spectrum::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (map == MAP_FAILED) {
+            std::cerr << "Cannot publish spectrum in " << name << ": " << std::strerror(errno) << "\n";
+            if (fd >= 0) close(fd);
+            return nullptr;
+        }
+        return std::unique_ptr<SpectrumPublisher>(
+            new SpectrumPublisher(name, fd, static_cast<shared_spectrum::Segment*>(map)));
+    }
+
+    // Unlinks while the lock is still held, then lets go of it. Subscribers
+    // still mapping the segment see it go stale and look for a successor.
+    ~SpectrumPublisher() {
+        begin_write();
+        seg->published_ns = 0;
+        seg->idle = 0;
+        end_write();
+        munmap(seg, sizeof(*seg));
+        shm_unlink(name.c_str());
+        close(fd);
+    }
+
+    SpectrumPublisher(const SpectrumPublisher&) = delete;
+    SpectrumPublisher& operator=(const SpectrumPublisher&) = delete;
+
+    void publish(const Analyzer& analyzer, bool connected) {
+        begin_write();
+        const std::vector<float>& levels = analyzer.levels();
+        seg->bar_count = (uint32_t)std::min(levels.size(), shared_spectrum::kMaxBars);
+        std::memcpy(seg->bars, levels.data(), seg->bar_count * sizeof(float));
+        seg->published_ns = steady_now_ns();
+        seg->audio_ns = analyzer.newest_arrival_ns();
+        seg->connected = connected;
+        seg->idle = 0;
+        seg->peak = analyzer.peak();
+        const LoudnessMeter* loudness = analyzer.get_loudness();
+        seg->momentary_lufs = loudness ? (float)loudness->momentary() : 0.0f;
+        seg->short_term_lufs = loudness ? (float)loudness->short_term() : 0.0f;
+        seg->gain_db = analyzer.get_gain_db();
+        const BeatDetector* beats = analyzer.get_beats();
+        seg->bpm = beats ? (float)beats->get_bpm() : 0.0f;
+        seg->beats = beats ? beats->get_beats() : 0;
+        end_write();
+    }
+
+    // Call before publishing stops; the next publish() clears it.
+    void set_idle() {
+        begin_write();
+        seg->published_ns = steady_now_ns();
+        seg->idle = 1;
+        end_write();
+    }
+
+private:
+    static constexpr int kMaxAttempts = 4;
+    uint32_t seq = 0; // even; only this process writes the segment
+
+    std::string name;
+    int fd; // holds the ownership lock
+    shared_spectrum::Segment* seg;
+
+    SpectrumPublisher(std::string name, int fd, shared_spectrum::Segment* seg)
+        : name(std::move(name)), fd(fd), seg(seg) {
+        // A fresh segment is zero-filled; a dead publisher's one is taken
+        // over, and if it died mid-write its odd seq is evened out first.
+        seq = seg->seq.load(std::memory_order_relaxed);
+        if (seq & 1) seg->seq.store(++seq, std::memory_order_relaxed);
+        std::memcpy(seg->magic, shared_spectrum::kMagic, sizeof(seg->magic));
+        seg->version = shared_spectrum::kVersion;
+        seg->size = sizeof(*seg);
+    }
+
+    void begin_write() {
+        seg->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_write() {
+        seq += 2;
+        seg->seq.store(seq, std::memory_order_release);
+    }
+
+    // Whether name still refers to the object open as fd.
+    static bool names_object(const std::string& name, int fd) {
+        int check = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (check < 0) return false;
+        struct stat a, b;
+        bool same = fstat(fd, &a) == 0 && fstat(check, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+        close(check);
+        return same;
+    }
+};
+
+class SpectrumSubscriber {
+public:
+    // Returns nullptr when no publisher has set up the segment.
+    static std::unique_ptr<SpectrumSubscriber> open() {
+        std::unique_ptr<SpectrumSubscriber> sub(new SpectrumSubscriber);
+        if (!sub->attach()) return nullptr;
+        return sub;
+    }
+
+    ~SpectrumSubscriber() { detach(); }
+
+    SpectrumSubscriber(const SpectrumSubscriber&) = delete;
+    SpectrumSubscriber& operator=(const SpectrumSubscriber&) = delete;
+
+    // Copies the latest consistent state into out and returns whether it is
+    // fresh (or idle, see Snapshot::idle). Stale data makes it look for a
+    // newer segment (a restarted publisher) first, which is the only time it
+    // makes syscalls; after a failed look it waits kRetryNs before the next.
+    bool read(shared_spectrum::Snapshot& out) {
+        if (seg && copy(out) && !is_stale(out)) return true;
+        int64_t now = steady_now_ns();
+        if (now < next_attach_ns) return false;
+        detach();
+        if (attach() && copy(out) && !is_stale(out)) return true;
+        next_attach_ns = now + kRetryNs;
+        return false;
+    }
+
+private:
+    static constexpr int kMaxRetries = 64;
+    static constexpr int64_t kRetryNs = 250000000;
+
+    const shared_spectrum::Segment* seg = nullptr;
+    int fd = -1; // kept open to probe the owner's lock
+    int64_t next_attach_ns = 0;
+
+    SpectrumSubscriber() = default;
+
+    // An idle segment stops aging, so it is stale only once nobody owns it
+    // (one syscall, and only idle reads make it).
+    bool is_stale(const shared_spectrum::Snapshot& s) const {
+        if (s.idle) return !has_owner();
+        return steady_now_ns() - s.published_ns > shared_spectrum::kStaleNs;
+    }
+
+    // Whether the publisher's exclusive flock is held: a shared lock on our
+    // own descriptor of the segment only goes through without it.
+    bool has_owner() const {
+        if (flock(fd, LOCK_SH | LOCK_NB) != 0) return errno == EWOULDBLOCK;
+        flock(fd, LOCK_UN);
+        return false;
+    }
+
+    bool attach() {
+        fd = shm_open(shared_spectrum::segment_name().c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) return false;
+        void* map = mmap(nullptr, sizeof(shared_spectrum::Segment), PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            detach();
+            return false;
+        }
+        seg = static_cast<const shared_spectrum::Segment*>(map);
+        if (std::memcmp(seg->magic, shared_spectrum::kMagic, sizeof(seg->magic)) != 0
+            || seg->version != shared_spectrum::kVersion || seg->size != sizeof(*seg)) {
+            detach();
+            return false;
+        }
+        return true;
+    }
+
+    void detach() {
+        if (seg) munmap(const_cast<shared_spectrum::Segment*>(seg), sizeof(*seg));
+        seg = nullptr;
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    bool copy(shared_spectrum::Snapshot& out) const {
+        for (int i = 0; i < kMaxRetries; ++i) {
+            uint32_t s1 = seg->seq.load(std::memory_order_acquire);
+            if (s1 & 1) continue;
+            uint32_t n = std::min<uint32_t>(seg->bar_count, shared_spectrum::kMaxBars);
+            out.bars.resize(n); // no-op once the size is settled
+            std::memcpy(out.bars.data(), seg->bars, n * sizeof(float));
+            out.published_ns = seg->published_ns;
+            out.audio_ns = seg->audio_ns;
+            out.connected = seg->connected != 0;
+            out.idle = seg->idle != 0;
+            out.peak = seg->peak;
+            out.momentary_lufs = seg->momentary_lufs;
+            out.short_term_lufs = seg->short_term_lufs;
+            out.gain_db = seg->gain_db;
+            out.bpm = seg->bpm;
+            out.beats = seg->beats;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seg->seq.load(std::memory_order_relaxed) == s1) return s1 != 0;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "capture.h"
+#include "signal_source.h"
+
+// Feeds the ring from a SignalSource on its own thread, in ~20 ms fragments
+// like the live backends. Paced, it sleeps to hand fragments over in real
+// time; fast, it produces whenever the ring has room, so the consumer sets
+// the speed and nothing is dropped.
+class SignalCapture : public CaptureBackend {
+public:
+    // Returns nullptr when the source can't be opened.
+    static std::unique_ptr<SignalCapture> create(const std::string& spec, CaptureProfile profile, bool paced) {
+        std::unique_ptr<SignalSource> source = SignalSource::open(spec, profile);
+        if (!source) return nullptr;
+        return std::unique_ptr<SignalCapture>(new SignalCapture(std::move(source), profile, paced));
+    }
+
+    ~SignalCapture() override {
+        running = false;
+        worker.join();
+    }
+
+    const char* get_name() const override { return "signal"; }
+
+private:
+    std::unique_ptr<SignalSource> source;
+    bool paced;
+    std::atomic<bool> running{true};
+    std::thread worker;
+
+    // Sources play at their own format (a file keeps its rate); Peaks folds
+    // them to the profile's level stream.
+    static unsigned ring_channels(CaptureProfile profile, const SignalSource& source) {
+        return profile == CaptureProfile::Peaks ? profile_channels(profile) : source.get_channels();
+    }
+
+    static unsigned ring_rate(CaptureProfile profile, const SignalSource& source) {
+        return profile == CaptureProfile::Peaks ? profile_rate(profile) : source.get_rate();
+    }
+
+    SignalCapture(std::unique_ptr<SignalSource> src, CaptureProfile profile, bool paced)
+        : CaptureBackend(profile, ring_channels(profile, *src), ring_rate(profile, *src)),
+          source(std::move(src)), paced(paced) {
+        connected = true;
+        worker = std::thread([this] { run(); });
+    }
+
+    void run() {
+        using clock = std::chrono::steady_clock;
+        const unsigned channels = source->get_channels();
+        const size_t frames = std::max(1u, source->get_rate() / 50);
+        const auto period = std::chrono::nanoseconds(frames * 1000000000ull / source->get_rate());
+        // Frames one fragment occupies in the ring once delivered.
+        const size_t ring_frames = profile == CaptureProfile::Peaks ? 2 : frames;
+        std::vector<float> fragment(frames * channels);
+
+        auto next = clock::now();
+        while (running) {
+            if (paced) {
+                next += period;
+                std::this_thread::sleep_until(next);
+            } else if (ring.get_capacity() - ring.available() < ring_frames) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            source->read(fragment.data(), frames);
+            if (profile == CaptureProfile::Peaks) {
+                deliver_peaks(fragment.data(), fragment.size(), source->get_rate() / kPeakRate * channels);
+            } else {
+                deliver(fragment.data(), frames);
+            }
+        }
+    }
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "dsp_tables.h"
+
+// Offline audio for headless runs: synthetic test signals, or a WAV / raw
+// PCM file looped forever. Produces interleaved float frames on demand and
+// knows nothing about pacing, so the capture backend and the bench can both
+// pull from it.
+class SignalSource {
+public:
+    virtual ~SignalSource() = default;
+
+    // Fills dst with count interleaved frames; never runs dry.
+    virtual void read(float* dst, size_t count) = 0;
+
+    unsigned get_rate() const { return rate; }
+    unsigned get_channels() const { return channels; }
+    const std::string& get_name() const { return name; }
+
+    // Names the generators accept in place of a file path.
+    static constexpr const char* kGenerators[] = {"sweep", "pink", "silence", "impulse"};
+
+    // spec is a generator name or a file path. Generators and raw files use
+    // the format the live stream would deliver for the profile, so a raw
+    // dump of a real capture replays as-is; WAV files carry their own.
+    // Returns nullptr (after saying why) when the spec can't be opened.
+    static std::unique_ptr<SignalSource> open(const std::string& spec, CaptureProfile profile);
+
+protected:
+    SignalSource(std::string name, unsigned rate, unsigned channels)
+        : rate(rate), channels(channels), name(std::move(name)) {}
+
+    unsigned rate;
+    unsigned channels;
+    std::string name;
+};
+
+namespace signal_source {
+
+// Logarithmic sine sweep from 20 Hz to just below Nyquist, restarting every
+// kPeriod seconds so every band gets its turn.
+class Sweep : public SignalSource {
+public:
+    Sweep(unsigned rate, unsigned channels) : SignalSource("sweep", rate, channels) {
+        high_hz = std::min(20000.0, rate * 0.45);
+    }
+
+    void read(float* dst, size_t count) override {
+        const size_t period = (size_t)(kPeriod * rate);
+        const double k = std::log(high_hz / kLowHz) / kPeriod;
+        for (size_t i = 0; i < count; ++i) {
+            double hz = kLowHz * std::exp(k * (double)position / rate);
+            phase += 2.0 * dsp::kPi * hz / rate;
+            if (phase > 2.0 * dsp::kPi) phase -= 2.0 * dsp::kPi;
+            float v = 0.5f * (float)std::sin(phase);
+            for (unsigned c = 0; c < channels; ++c) *dst++ = v;
+            if (++position == period) position = 0;
+        }
+    }
+
+private:
+    static constexpr double kLowHz = 20.0;
+    static constexpr double kPeriod = 10.0;
+    double high_hz;
+    double phase = 0.0;
+    size_t position = 0;
+};
+
+// Pink (1/f) noise from white noise through Paul Kellet's economy filter,
+// about -10 dBFS RMS. Seeded, so runs are reproducible.
+class Pink : public SignalSource {
+public:
+    Pink(unsigned rate, unsigned channels) : SignalSource("pink", rate, channels) {}
+
+    void read(float* dst, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            float white = (float)(seed >> 8) / (1u << 23) - 1.0f;
+            b0 = 0.99765f * b0 + white * 0.0990460f;
+            b1 = 0.96300f * b1 + white * 0.2965164f;
+            b2 = 0.57000f * b2 + white * 1.0526913f;
+            float v = (b0 + b1 + b2 + white * 0.1848f) * 0.05f;
+            for (unsigned c = 0; c < channels; ++c) *dst++ = v;
+        }
+    }
+
+private:
+    uint32_t seed = 12345;
+    float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+};
+
+class Silence : public SignalSource {
+public:
+    Silence(unsigned rate, unsigned channels) : SignalSource("silence", rate, channels) {}
+
+    void read(float* dst, size_t count) override {
+        std::fill(dst, dst + count * channels, 0.0f);
+    }
+};
+
+// One full-scale sample a second: flat spectrum, worst case for the peak
+// and attack paths.
+class Impulse : public SignalSource {
+public:
+    Impulse(unsigned rate, unsigned channels) : SignalSource("impulse", rate, channels) {}
+
+    void read(float* dst, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            float v = position == 0 ? 1.0f : 0.0f;
+            for (unsigned c = 0; c < channels; ++c) *dst++ = v;
+            if (++position == rate) position = 0;
+        }
+    }
+
+private:
+    size_t position = 0;
+};
+
+// A whole file decoded to float up front and looped.
+class Clip : public SignalSource {
+public:
+    Clip(std::string name, unsigned rate, unsigned channels, std::vector<float> samples)
+        : SignalSource(std::move(name), rate, channels), samples(std::move(samples)) {}
+
+    void read(float* dst, size_t count) override {
+        size_t frames = samples.size() / channels;
+        while (count > 0) {
+            size_t take = std::min(count, frames - position);
+            std::memcpy(dst, samples.data() + position * channels, take * channels * sizeof(float));
+            dst += take * channels;
+            count -= take;
+            position += take;
+            if (position == frames) position = 0;
+        }
+    }
+
+private:
+    std::vector<float> samples;
+    size_t position = 0;
+};
+
+inline uint32_t le32(const char* p) {
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return u[0] | u[1] << 8 | u[2] << 16 | (uint32_t)u[3] << 24;
+}
+
+inline uint16_t le16(const char* p) {
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return u[0] | u[1] << 8;
+}
+
+inline void decode(const char* bytes, size_t size, bool is_float, std::vector<float>& out) {
+    if (is_float) {
+        out.resize(size / sizeof(float));
+        std::memcpy(out.data(), bytes, out.size() * sizeof(float));
+    } else {
+        out.resize(size / 2);
+        for (size_t i = 0; i < out.size(); ++i) out[i] = (int16_t)le16(bytes + 2 * i) / 32768.0f;
+    }
+}
+
+// Reads 16-bit PCM or 32-bit float WAV (including WAVE_FORMAT_EXTENSIBLE).
+inline std::unique_ptr<SignalSource> open_wav(const std::string& path, const std::string& data) {
+    if (data.size() < 12 || data.compare(0, 4, "RIFF") != 0 || data.compare(8, 4, "WAVE") != 0) {
+        std::cerr << path << ": not a RIFF/WAVE file\n";
+        return nullptr;
+    }
+    unsigned tag = 0, channels = 0, rate = 0, bits = 0;
+    const char* pcm = nullptr;
+    size_t pcm_size = 0;
+    for (size_t pos = 12; pos + 8 <= data.size();) {
+        const char* chunk = data.data() + pos;
+        size_t size = std::min<size_t>(le32(chunk + 4), data.size() - pos - 8);
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            tag = le16(chunk + 8);
+            channels = le16(chunk + 10);
+            rate = le32(chunk + 12);
+            bits = le16(chunk + 22);
+            if (tag == 0xFFFE && size >= 26) tag = le16(chunk + 32); // sub-format GUID
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            pcm = chunk + 8;
+            pcm_size = size;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    bool is_float = tag == 3 && bits == 32;
+    if (!(is_float || (tag == 1 && bits == 16)) || channels == 0 || rate == 0 || !pcm) {
+        std::cerr << path << ": only 16-bit PCM and 32-bit float WAV are supported\n";
+        return nullptr;
+    }
+    std::vector<float> samples;
+    decode(pcm, pcm_size - pcm_size % (channels * bits / 8), is_float, samples);
+    if (samples.empty()) {
+        std::cerr << path << ": no audio\n";
+        return nullptr;
+    }
+    return std::make_unique<Clip>(path, rate, channels, std::move(samples));
+}
+
+} // namespace signal_source
+
+inline std::unique_ptr<SignalSource> SignalSource::open(const std::string& spec, CaptureProfile profile) {
+    using namespace signal_source;
+    // Format the live stream would deliver. Peaks is generated at the rate
+    // PipeWire folds levels from and folded by SignalCapture the same way.
+    unsigned rate = profile == CaptureProfile::Peaks ? kPeakSourceRate : profile_rate(profile);
+    unsigned channels = profile_channels(profile);
+    if (spec == "sweep") return std::make_unique<Sweep>(rate, channels);
+    if (spec == "pink") return std::make_unique<Pink>(rate, channels);
+    if (spec == "silence") return std::make_unique<Silence>(rate, channels);
+    if (spec == "impulse") return std::make_unique<Impulse>(rate, channels);
+
+    std::ifstream in(spec, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open audio source " << spec << "\n";
+        return nullptr;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.compare(0, 4, "RIFF") == 0) return open_wav(spec, data);
+
+    // Raw: F32 for Full and Peaks, S16 for Compact, as the record stream sends.
+    bool is_float = profile != CaptureProfile::Compact;
+    size_t frame_bytes = channels * (is_float ? sizeof(float) : 2);
+    std::vector<float> samples;
+    decode(data.data(), data.size() - data.size() % frame_bytes, is_float, samples);
+    if (samples.empty()) {
+        std::cerr << spec << ": no audio\n";
+        return nullptr;
+    }
+    return std::make_unique<Clip>(spec, rate, channels, std::move(samples));
+}
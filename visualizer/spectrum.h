@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "dsp_tables.h"
+#include "sample_ring.h"
+
+// Windowed real-input FFT over the last `size` frames, advancing every `hop`
+// frames. Everything is allocated up front, so feed() never touches the heap.
+// The complex FFT works on split re/im arrays with per-stage contiguous
+// twiddles, which keeps every butterfly loop unit-stride and lets the
+// compiler vectorize it.
+//
+// Transforms are lazy: feed() only deinterleaves into the window history and
+// magnitudes() transforms the latest complete window if it has not been yet.
+// The UI reads one spectrum per tick, so hops it would never see cost nothing.
+// With split channels every channel gets its own history and spectrum
+// instead of a mono mixdown.
+class SpectrumAnalyzer {
+public:
+    using Window = dsp::WindowShape;
+
+    struct Stats {
+        uint64_t transforms;
+        double last_us;   // cost of the most recent transform
+        double avg_us;    // exponential average over recent transforms
+        double max_us;
+    };
+
+    SpectrumAnalyzer(size_t size, size_t hop, unsigned channels, unsigned rate,
+                     Window window = Window::Hann, bool split_channels = false)
+        : n(size), half(size / 2), hop(hop), channels(channels), rate(rate),
+          outputs(split_channels ? channels : 1) {
+        // Per output: the latest complete window, then room for the next hop.
+        history.assign(outputs * (n + hop), 0.0f);
+        // Common sizes come from the compile-time tables in dsp_tables.h.
+        win.resize(n);
+        const float* table = dsp::find_window(n, window);
+        double sum = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            win[i] = table ? table[i] : (float)dsp::window_at(window, i, n);
+            sum += win[i];
+        }
+        // A full-scale sine lands on magnitude 1.0.
+        norm = (float)(2.0 / sum);
+
+        re.resize(half);
+        im.resize(half);
+        rev.resize(half);
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < half) ++bits;
+        for (size_t i = 0; i < half; ++i) {
+            size_t r = 0;
+            for (unsigned b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+            rev[i] = (uint32_t)r;
+        }
+        for (size_t len = 2; len <= half; len <<= 1) {
+            for (size_t j = 0; j < len / 2; ++j) {
+                double a = -2.0 * M_PI * j / len;
+                tw_re.push_back((float)std::cos(a));
+                tw_im.push_back((float)std::sin(a));
+            }
+        }
+        post_re.resize(half);
+        post_im.resize(half);
+        for (size_t k = 0; k < half; ++k) {
+            double a = -2.0 * M_PI * k / n;
+            post_re[k] = (float)std::cos(a);
+            post_im[k] = (float)std::sin(a);
+        }
+        mags.assign(outputs * (half + 1), 0.0f);
+        fresh.assign(outputs, true);
+    }
+
+    size_t get_size() const { return n; }
+    size_t get_bins() const { return half + 1; }
+    unsigned get_rate() const { return rate; }
+    float bin_hz(size_t bin) const { return (float)bin * rate / n; }
+    // Spectra produced per window: the channel count when split, else 1.
+    unsigned get_outputs() const { return outputs; }
+    // Frames feed() still needs before the next window completes.
+    size_t frames_to_hop() const { return hop - pending; }
+
+    // Consumes interleaved frames, mixing them down to mono or splitting them
+    // per channel straight from the interleaved input. Returns how many hops
+    // completed, i.e. whether magnitudes() has anything new.
+    size_t feed(const float* frames, size_t count) {
+        const size_t stride = n + hop;
+        size_t done = 0;
+        while (count > 0) {
+            size_t take = std::min(count, hop - pending);
+            float* dst = &history[n + pending];
+            if (outputs == 1) {
+                const float scale = 1.0f / channels;
+                for (size_t i = 0; i < take; ++i) {
+                    float s = 0.0f;
+                    for (unsigned c = 0; c < channels; ++c) s += frames[i * channels + c];
+                    dst[i] = s * scale;
+                }
+            } else {
+                for (unsigned c = 0; c < channels; ++c) {
+                    float* d = dst + c * stride;
+                    for (size_t i = 0; i < take; ++i) d[i] = frames[i * channels + c];
+                }
+            }
+            frames += take * channels;
+            count -= take;
+            pending += take;
+            if (pending == hop) {
+                for (unsigned o = 0; o < outputs; ++o) {
+                    float* h = &history[o * stride];
+                    std::memmove(h, h + hop, n * sizeof(float));
+                }
+                std::fill(fresh.begin(), fresh.end(), false);
+                pending = 0;
+                ++done;
+            }
+        }
+        return done;
+    }
+
+    // Linear magnitudes of bins 0..size/2 of output's latest complete window,
+    // transforming it first if nobody has asked since it completed.
+    const float* magnitudes(unsigned output = 0) {
+        float* m = &mags[output * (half + 1)];
+        if (!fresh[output]) {
+            transform(&history[output * (n + hop)], m);
+            fresh[output] = true;
+        }
+        return m;
+    }
+
+    Stats get_stats() const { return stats; }
+
+private:
+    size_t n, half, hop;
+    unsigned channels, rate;
+    unsigned outputs;
+    size_t pending = 0;
+    float norm;
+    std::vector<float> history, win;
+    std::vector<float> re, im;
+    std::vector<uint32_t> rev;
+    std::vector<float> tw_re, tw_im;
+    std::vector<float> post_re, post_im;
+    std::vector<float> mags;
+    std::vector<char> fresh; // per output: mags matches the latest window
+    Stats stats = {0, 0.0, 0.0, 0.0};
+
+    void transform(const float* x, float* out) {
+        int64_t start = steady_now_ns();
+
+        // Pack even/odd samples as one complex sequence of half the length.
+        for (size_t k = 0; k < half; ++k) {
+            uint32_t r = rev[k];
+            re[r] = x[2 * k] * win[2 * k];
+            im[r] = x[2 * k + 1] * win[2 * k + 1];
+        }
+
+        const float* wr = tw_re.data();
+        const float* wi = tw_im.data();
+        for (size_t len = 2; len <= half; len <<= 1) {
+            size_t h = len / 2;
+            for (size_t base = 0; base < half; base += len) {
+                float* ar = &re[base];
+                float* ai = &im[base];
+                float* br = &re[base + h];
+                float* bi = &im[base + h];
+                for (size_t j = 0; j < h; ++j) {
+                    float tr = br[j] * wr[j] - bi[j] * wi[j];
+                    float ti = br[j] * wi[j] + bi[j] * wr[j];
+                    br[j] = ar[j] - tr;
+                    bi[j] = ai[j] - ti;
+                    ar[j] += tr;
+                    ai[j] += ti;
+                }
+            }
+            wr += h;
+            wi += h;
+        }
+
+        // Split the packed spectrum back into the real-input spectrum.
+        out[0] = std::abs(re[0] + im[0]) * norm * 0.5f;
+        out[half] = std::abs(re[0] - im[0]) * norm * 0.5f;
+        for (size_t k = 1; k < half; ++k) {
+            float zr = re[k], zi = im[k];
+            float cr = re[half - k], ci = -im[half - k];
+            float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+            float dr = 0.5f * (zr - cr), di = 0.5f * (zi - ci);
+            // odd = -i * d
+            float or_ = di, oi = -dr;
+            float xr = er + or_ * post_re[k] - oi * post_im[k];
+            float xi = ei + or_ * post_im[k] + oi * post_re[k];
+            out[k] = std::sqrt(xr * xr + xi * xi) * norm;
+        }
+
+        double us = (steady_now_ns() - start) / 1000.0;
+        stats.last_us = us;
+        stats.avg_us = stats.transforms ? stats.avg_us * 0.95 + us * 0.05 : us;
+        stats.max_us = std::max(stats.max_us, us);
+        ++stats.transforms;
+    }
+};
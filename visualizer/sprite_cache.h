@@ -0,0 +1,44 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <cstdint>
+#include <vector>
+
+// The bar-top sprite, rescaled once per size and kept as a premultiplied
+// Cairo image surface at the window's device scale, so drawing it on a bar
+// is a plain blit. Every bar of a frame shares one size, so there is rarely
+// more than one entry; the widget clears the cache when its allocation or
+// scale factor changes.
+class SpriteCache {
+public:
+    explicit SpriteCache(Glib::RefPtr<Gdk::Pixbuf> image) : image(std::move(image)) {}
+
+    explicit operator bool() const { return (bool)image; }
+
+    // The sprite as size x size logical pixels (size * scale device pixels).
+    Cairo::RefPtr<Cairo::Surface> get(int size, int scale, GdkWindow* window) {
+        for (const Entry& e : entries) {
+            if (e.size == size && e.scale == scale) return e.surface;
+        }
+        // Nearest keeps the pixel art crisp, as the old per-bar scale did.
+        Glib::RefPtr<Gdk::Pixbuf> scaled = image->scale_simple(size * scale, size * scale, Gdk::INTERP_NEAREST);
+        cairo_surface_t* s = gdk_cairo_surface_create_from_pixbuf(scaled->gobj(), scale, window);
+        entries.push_back({size, scale, Cairo::RefPtr<Cairo::Surface>(new Cairo::Surface(s, true))});
+        ++rescales;
+        return entries.back().surface;
+    }
+
+    void clear() { entries.clear(); }
+
+    uint64_t get_rescales() const { return rescales; }
+
+private:
+    struct Entry {
+        int size, scale;
+        Cairo::RefPtr<Cairo::Surface> surface;
+    };
+
+    Glib::RefPtr<Gdk::Pixbuf> image;
+    std::vector<Entry> entries;
+    uint64_t rescales = 0;
+};
@@ -0,0 +1,811 @@
+#pragma once
+
+#include <gtkmm.h>
+#include <gtk-layer-shell/gtk-layer-shell.h>
+#include <glib-unix.h>
+#include <climits>
+#include <csignal>
+#include <vector>
+#include <cmath>
+#include <iostream>
+
+#include "analysis.h"
+#include "backends.h"
+#include "bar_raster.h"
+#include "config.h"
+#include "latency.h"
+#include "palette.h"
+#include "radial.h"
+#include "scope.h"
+#include "shared_spectrum.h"
+#include "sprite_cache.h"
+#include "waterfall.h"
+
+// Everything that differs between the light and dark visualizer builds.
+struct Theme {
+    const char* sprite; // file name under ~/.config/Elysia/assets/assets/
+    std::vector<GradientStop> gradient; // bar color by intensity, see Palette
+};
+
+class Visualizer : public Gtk::DrawingArea {
+public:
+    // Captures and analyzes locally, sharing the results if publisher is set.
+    Visualizer(CaptureBackend& m, const Theme& t, const VisualizerConfig& config,
+               SpectrumPublisher* publisher = nullptr)
+        : Visualizer(t, config, std::make_unique<Analyzer>(config, m.get_profile(), m.get_rate(),
+                                                           m.samples().get_channels())) {
+        meter = &m;
+        this->publisher = publisher;
+        // Without a wake fd nothing could end Watching, so never enter it.
+        if (meter->get_wake_fd() >= 0) {
+            idle_after_ns = config.idle_after * 1000000000ll;
+            Glib::signal_io().connect([this](Glib::IOCondition) {
+                uint64_t n;
+                ssize_t r = ::read(meter->get_wake_fd(), &n, sizeof(n));
+                (void)r;
+                resume();
+                return true;
+            }, meter->get_wake_fd(), Glib::IO_IN);
+        }
+    }
+
+    // Draws what another process publishes; no capture or analysis here.
+    Visualizer(SpectrumSubscriber& s, const Theme& t, const VisualizerConfig& config)
+        : Visualizer(t, config, nullptr, shared_bar_count(s, config)) {
+        subscriber = &s;
+    }
+
+    void dump_stats(std::ostream& out) {
+        if (!analyzer) {
+            out << "shared: live=" << shared_live << " connected=" << shared.connected
+                << " bars=" << shared.bars.size() << " peak=" << shared.peak
+                << " momentary_lufs=" << shared.momentary_lufs << " short_term_lufs=" << shared.short_term_lufs
+                << " gain_db=" << shared.gain_db << " bpm=" << shared.bpm << " beats=" << shared.beats
+                << " idle=" << shared.idle << "\n"
+                << "power: state=" << (!paused ? "active" : hidden ? "hidden" : "idle") << " pauses=" << pauses << "\n"
+                << "sprites: rescales=" << sprites.get_rescales() << "\n";
+            dump_damage(out);
+            return;
+        }
+        CaptureBackend::Stats s = meter->get_stats();
+        out << "capture: backend=" << meter->get_name() << " latency_us=" << meter->get_latency_us()
+            << " fragments=" << s.fragments << " bytes=" << s.bytes
+            << " holes=" << s.holes << " hole_bytes=" << s.hole_bytes
+            << " server_overruns=" << s.server_overruns << " read_errors=" << s.read_errors
+            << " reconnects=" << s.reconnects << " moves=" << s.moves << "\n"
+            << "power: state=" << (!paused ? "active" : hidden ? "hidden" : "idle")
+            << " pauses=" << pauses << " wakeups=" << s.wakeups << "\n"
+            << "ring: overruns=" << s.ring.overruns << " dropped_frames=" << s.ring.dropped_frames
+            << " underruns=" << s.ring.underruns << "\n";
+        Analyzer::Stats a = analyzer->get_stats();
+        out << "analysis: updates=" << a.updates << " avg_us=" << a.avg_us
+            << " max_us=" << a.max_us << "\n";
+        if (const LoudnessMeter* loudness = analyzer->get_loudness()) {
+            out << "loudness: momentary_lufs=" << loudness->momentary()
+                << " short_term_lufs=" << loudness->short_term()
+                << " gain_db=" << analyzer->get_gain_db() << "\n";
+        }
+        if (const BeatDetector* beats = analyzer->get_beats()) {
+            BeatDetector::Stats b = beats->get_stats();
+            out << "beats: bpm=" << beats->get_bpm() << " onsets=" << b.onsets << " beats=" << b.beats
+                << " avg_us=" << b.avg_us << " max_us=" << b.max_us << "\n";
+        }
+        if (const SpectrumAnalyzer* spectrum = analyzer->get_spectrum()) {
+            SpectrumAnalyzer::Stats f = spectrum->get_stats();
+            out << "fft: transforms=" << f.transforms << " avg_us=" << f.avg_us
+                << " max_us=" << f.max_us << "\n";
+        }
+        out << "sprites: rescales=" << sprites.get_rescales() << "\n";
+        if (mode == ViewMode::Scope) {
+            out << "scope: frames=" << scope.get_frames() << " triggered=" << scope.get_triggered() << "\n";
+        }
+        dump_damage(out);
+        latency.dump(out);
+    }
+
+private:
+    // Redrawn area per frame against the whole widget.
+    void dump_damage(std::ostream& out) const {
+        uint64_t full = (uint64_t)std::max(0, shapes_width) * std::max(0, shapes_height);
+        uint64_t avg = damage_frames ? damage_px / damage_frames : 0;
+        out << "damage: frames=" << damage_frames << " avg_px=" << avg << " full_px=" << full
+            << " avg_pct=" << (full ? 100.0 * avg / full : 0.0) << "\n";
+    }
+
+    CaptureBackend* meter = nullptr;
+    Theme theme;
+    std::unique_ptr<Analyzer> analyzer; // null when drawing a publisher's results
+    SpectrumPublisher* publisher = nullptr;
+    SpectrumSubscriber* subscriber = nullptr;
+    shared_spectrum::Snapshot shared;
+    bool shared_live = false;
+    std::vector<float> shared_levels; // shared bars resampled to bar_count
+    int bar_count;
+    std::vector<float> bands;   // smoothed bar levels, 0..1 of the widget height
+    bool centered;              // split leftover pixels evenly so mirrored halves match
+    SpriteCache sprites;
+    ViewMode mode;
+    Palette palette;
+    BarRaster bar_raster;
+    Cairo::RefPtr<Cairo::ImageSurface> bar_pixels; // retained, device pixels
+    RadialLayout radial;
+    int radial_width = -1, radial_height = -1; // allocation radial is laid out for
+    Waterfall waterfall;
+    Cairo::RefPtr<Cairo::ImageSurface> waterfall_pixels; // ring of rows, device pixels
+    Scope scope;
+    Cairo::RefPtr<Cairo::ImageSurface> scope_pixels; // retained, device pixels
+    std::vector<float> scope_history;                // scope.get_history() mono frames
+    float level = 0.0f;
+
+    // Beat pulse: jumps to 1 on every detected beat and decays between them.
+    // Bars stretch and the sprites bounce with it.
+    static constexpr float kPulseDecay = 0.6f; // per kReferenceStep
+    static constexpr float kPulseStretch = 0.15f;
+    static constexpr int kBouncePx = 8;
+    uint64_t seen_beats = 0;
+    float pulse = 0.0f;
+
+    // Animation runs off the GDK frame clock: a tick callback fires once per
+    // monitor refresh and does the work on frames at least frame_interval_us
+    // apart. Smoothing and the pulse decay are defined per kReferenceStep (the
+    // old fixed tick) and scaled to the real frame delta, so motion keeps its
+    // speed at any frame rate or when frames come late. Analysis only runs
+    // once new audio is in, at most kMaxAnalysisHz, so a faster panel costs
+    // extra draws but not extra transforms.
+    static constexpr double kReferenceStep = 0.067; // seconds
+    static constexpr float kBandRetain = 0.65f;     // per kReferenceStep
+    static constexpr double kMaxStep = 0.25;        // longer gaps animate as this
+    static constexpr int64_t kFrameSlackUs = 2000;  // frame clock jitter
+    static constexpr int kMaxAnalysisHz = 50;       // one capture fragment
+    guint tick_id = 0;
+    int64_t frame_interval_us;
+    int64_t next_frame_us = 0;
+    int64_t last_frame_us = 0;
+    int64_t next_analysis_ns = 0;
+    bool starved = false; // the due analysis found the ring empty, already counted
+
+    // Power saving. After idle_after_ns of digital silence capture goes to
+    // Watching and the tick callback goes away; sound brings both back through
+    // the wake fd within a fragment. While unmapped capture is Paused outright
+    // and only mapping again resumes, unless we publish: subscribers still
+    // want the spectrum, so a hidden publisher only stops drawing and keeps
+    // analyzing and publishing from a timer. Only silence makes a publisher
+    // pause and mark the segment idle; its subscribers then stop too and poll
+    // the segment every kIdlePollMs (a copy, no syscalls) until it publishes
+    // again.
+    static constexpr int kIdlePollMs = 250;
+    int64_t idle_after_ns = 0; // 0 = never idle on silence
+    int64_t resumed_ns = 0;
+    bool paused = false;
+    bool hidden = false;
+    uint64_t pauses = 0;
+    sigc::connection idle_poll;    // subscriber waiting out an idle publisher
+    sigc::connection hidden_timer; // hidden publisher, instead of the tick callback
+
+    Visualizer(const Theme& t, const VisualizerConfig& config, std::unique_ptr<Analyzer> a, int bars = 0)
+        : theme(t), analyzer(std::move(a)), shared_levels(analyzer ? 0 : bars),
+          bar_count(analyzer ? analyzer->get_bar_count() : bars), bands(bar_count, 0.0f),
+          centered(config.layout == BarLayout::Mirror), sprites(load_sprite(t)),
+          // Only local capture has a waveform; subscribers show the bars.
+          mode(config.mode == ViewMode::Scope && !analyzer ? ViewMode::Bars : config.mode),
+          palette(config.gradient.empty() ? t.gradient : config.gradient),
+          bar_raster(palette), waterfall(palette), scope(palette),
+          frame_interval_us(1000000 / config.fps) {
+        set_size_request(-1, 200);
+        property_scale_factor().signal_changed().connect([this] { sprites.clear(); });
+
+        start_ticking();
+    }
+
+    // Unmapped there is no frame clock, so a hidden publisher runs on a timer.
+    void start_ticking() {
+        resumed_ns = steady_now_ns();
+        last_frame_us = 0;
+        if (hidden) {
+            hidden_timer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Visualizer::publish_hidden),
+                                                          std::max<int64_t>(1, frame_interval_us / 1000));
+        } else {
+            tick_id = add_tick_callback(sigc::mem_fun(*this, &Visualizer::on_frame));
+        }
+    }
+
+    void stop_ticking() {
+        hidden_timer.disconnect();
+        if (tick_id) remove_tick_callback(tick_id);
+        tick_id = 0;
+    }
+
+    static Glib::RefPtr<Gdk::Pixbuf> load_sprite(const Theme& theme) {
+        try {
+            std::string path = std::string(std::getenv("HOME")) + "/.config/Elysia/assets/assets/" + theme.sprite;
+            return Gdk::Pixbuf::create_from_file(path);
+        } catch (...) {
+            std::cerr << "Failed to load image\n";
+            return {};
+        }
+    }
+
+    void on_size_allocate(Gtk::Allocation& allocation) override {
+        if (allocation.get_width() != get_allocated_width() || allocation.get_height() != get_allocated_height()) {
+            sprites.clear();
+        }
+        Gtk::DrawingArea::on_size_allocate(allocation);
+    }
+
+    void on_map() override {
+        Gtk::DrawingArea::on_map();
+        hidden = false;
+        if (paused) {
+            resume();
+        } else {
+            stop_ticking();
+            start_ticking();
+        }
+    }
+
+    void on_unmap() override {
+        hidden = true;
+        if (publisher && !paused) {
+            stop_ticking();
+            start_ticking();
+        } else {
+            pause();
+        }
+        Gtk::DrawingArea::on_unmap();
+    }
+
+    void pause() {
+        bool stop = hidden && !publisher;
+        if (meter) meter->set_activity(stop ? CaptureBackend::Activity::Paused : CaptureBackend::Activity::Watching);
+        if (paused) return;
+        paused = true;
+        ++pauses;
+        if (publisher) publisher->set_idle();
+        stop_ticking();
+    }
+
+    void wait_for_publisher() {
+        pause();
+        idle_poll = Glib::signal_timeout().connect([this] {
+            shared_live = subscriber->read(shared);
+            if (shared_live && shared.idle) return true;
+            resume();
+            return false;
+        }, kIdlePollMs);
+    }
+
+    // Also runs for wakeups that come in after a resume already happened.
+    void resume() {
+        if (!paused || (hidden && !publisher)) return;
+        paused = false;
+        idle_poll.disconnect();
+        if (meter) meter->set_activity(CaptureBackend::Activity::Capturing);
+        start_ticking();
+    }
+
+    // Silence counts from the last resume at the latest, so bars left over
+    // from before get to settle first.
+    bool is_silent_for_long() const {
+        int64_t since = std::max(meter->last_sound_ns(), resumed_ns);
+        return idle_after_ns > 0 && steady_now_ns() - since > idle_after_ns;
+    }
+
+    // Frame times are the frame clock's, in g_get_monotonic_time() microseconds.
+    bool on_frame(const Glib::RefPtr<Gdk::FrameClock>& clock) {
+        int64_t now_us = clock->get_frame_time();
+        if (now_us + kFrameSlackUs < next_frame_us) return true;
+        next_frame_us += frame_interval_us;
+        if (next_frame_us <= now_us) next_frame_us = now_us + frame_interval_us;
+        double dt = last_frame_us ? std::min(kMaxStep, (now_us - last_frame_us) / 1e6) : frame_interval_us / 1e6;
+        last_frame_us = now_us;
+        return tick(dt);
+    }
+
+    bool tick(double dt) {
+        uint64_t beats = 0;
+        if (analyzer) {
+            if (is_silent_for_long()) {
+                pause();
+                return false;
+            }
+            analyze();
+            if (const BeatDetector* b = analyzer->get_beats()) beats = b->get_beats();
+        } else {
+            int64_t seen = shared.audio_ns;
+            read_shared();
+            if (shared_live && shared.idle) {
+                wait_for_publisher();
+                return false;
+            }
+            fresh_levels = shared.audio_ns != seen;
+            beats = shared.beats;
+        }
+        collect_presented();
+        double steps = dt / kReferenceStep;
+        follow_beats(beats, std::pow(kPulseDecay, (float)steps));
+        const std::vector<float>& targets = analyzer ? analyzer->levels() : shared_levels;
+        float retain = std::pow(kBandRetain, (float)steps);
+        for (int i = 0; i < bar_count; ++i) {
+            bands[i] = bands[i] * retain + targets[i] * (1.0f - retain);
+        }
+        if (mode != ViewMode::Bars) {
+            if (mode == ViewMode::Waterfall && fresh_levels) push_row(targets);
+            if (mode == ViewMode::Scope && fresh_audio && render_scope()) queue_draw();
+            if (mode == ViewMode::Radial) queue_draw();
+            if (is_quiet() != showing_no_audio) {
+                showing_no_audio = is_quiet();
+                queue_draw();
+            }
+        } else {
+            queue_damage();
+        }
+        fresh_levels = false;
+        fresh_audio = false;
+        return true;
+    }
+
+    // Drains the ring when an analysis is due and publishes the result. A
+    // due analysis that finds the ring empty is an underrun, counted once
+    // until audio comes in again.
+    void analyze() {
+        int64_t now = steady_now_ns();
+        if (now >= next_analysis_ns && meter->samples().available() > 0) {
+            next_analysis_ns = now + 1000000000 / kMaxAnalysisHz;
+            starved = false;
+            int64_t seen = analyzer->newest_arrival_ns();
+            fresh_levels = analyzer->update(meter->samples());
+            fresh_audio = analyzer->newest_arrival_ns() != seen;
+            if (fresh_audio && !hidden) note_analysis();
+            level = analyzer->peak();
+        } else if (now >= next_analysis_ns && !starved) {
+            meter->samples().note_underrun();
+            starved = true;
+        }
+        if (publisher) publisher->publish(*analyzer, meter->is_connected());
+    }
+
+    // The hidden publisher's tick: analysis and publishing, nothing drawn.
+    bool publish_hidden() {
+        if (is_silent_for_long()) {
+            pause();
+            return false;
+        }
+        analyze();
+        fresh_levels = false;
+        fresh_audio = false;
+        return true;
+    }
+
+    // Waterfall rows are the raw levels, unsmoothed: each row is its own
+    // moment. Everything on screen moves, so the whole widget is redrawn.
+    void push_row(const std::vector<float>& levels) {
+        if (!waterfall_pixels) return; // first draw sets it up
+        waterfall_pixels->flush();
+        waterfall.push(waterfall_pixels->get_data(), waterfall_pixels->get_stride(), levels.data());
+        waterfall_pixels->mark_dirty();
+        queue_draw();
+    }
+
+    // The scope redraws from the newest audio whenever some arrived. Only
+    // the columns that changed are rewritten, but the whole widget is
+    // composited; returns whether there is anything new to show.
+    bool render_scope() {
+        if (!scope_pixels) return false; // first draw sets it up
+        analyzer->waveform(scope_history.data(), scope_history.size());
+        scope_pixels->flush();
+        if (!scope.draw(scope_pixels->get_data(), scope_pixels->get_stride(), scope_history.data())) return false;
+        scope_pixels->mark_dirty();
+        return true;
+    }
+
+    static int shared_bar_count(SpectrumSubscriber& s, const VisualizerConfig& config) {
+        shared_spectrum::Snapshot snapshot;
+        return s.read(snapshot) && !snapshot.bars.empty() ? (int)snapshot.bars.size() : config.bars;
+    }
+
+    // The publisher may run a different bar count; sample its bars evenly.
+    void read_shared() {
+        shared_live = subscriber->read(shared);
+        level = shared_live ? shared.peak : 0.0f;
+        size_t n = shared.bars.size();
+        for (int i = 0; i < bar_count; ++i) {
+            shared_levels[i] = shared_live && n > 0 ? shared.bars[i * n / bar_count] : 0.0f;
+        }
+    }
+
+    bool is_live() const { return meter ? meter->is_connected() : shared_live && shared.connected; }
+
+    void follow_beats(uint64_t n, float decay) {
+        pulse = n != seen_beats ? 1.0f : pulse * decay;
+        seen_beats = n;
+    }
+
+    // Capture-to-photon bookkeeping, see LatencyStages. A tick that consumed
+    // new audio marks the next draw as showing it; drawn frames then wait in
+    // in_flight until GDK reports when they reached the screen.
+    struct Frame {
+        int64_t counter;    // GdkFrameClock frame counter
+        int64_t arrival_ns; // newest audio shown
+        int64_t stream_us;  // its age when delivered
+        int64_t draw_ns;
+    };
+    static constexpr size_t kMaxInFlight = 16; // GDK keeps timings for as many frames
+
+    LatencyStages latency;
+    bool fresh = false;
+    int64_t fresh_stream_us = 0;
+    std::vector<Frame> in_flight;
+
+    void note_analysis() {
+        fresh = true;
+        fresh_stream_us = std::max<int64_t>(0, meter->get_latency_us());
+        latency.stream.add(fresh_stream_us);
+        latency.ring.add((analyzer->update_started_ns() - analyzer->newest_arrival_ns()) / 1000.0);
+        latency.analysis.add((analyzer->update_finished_ns() - analyzer->update_started_ns()) / 1000.0);
+    }
+
+    void note_draw(int64_t draw_ns) {
+        if (!fresh) return;
+        fresh = false;
+        latency.draw.add((draw_ns - analyzer->update_finished_ns()) / 1000.0);
+        GdkFrameClock* clock = gtk_widget_get_frame_clock(GTK_WIDGET(gobj()));
+        if (!clock || in_flight.size() >= kMaxInFlight) return;
+        in_flight.push_back({gdk_frame_clock_get_frame_counter(clock), analyzer->newest_arrival_ns(),
+                             fresh_stream_us, draw_ns});
+    }
+
+    // Presentation times are in g_get_monotonic_time() microseconds. Frames
+    // GDK no longer has timings for, or that the compositor never reported a
+    // time for (presentation-time unsupported), are dropped uncounted.
+    void collect_presented() {
+        GdkFrameClock* clock = gtk_widget_get_frame_clock(GTK_WIDGET(gobj()));
+        auto done = [&](const Frame& f) {
+            GdkFrameTimings* t = clock ? gdk_frame_clock_get_timings(clock, f.counter) : nullptr;
+            if (!t) return true;
+            if (!gdk_frame_timings_get_complete(t)) return false;
+            int64_t presented_us = gdk_frame_timings_get_presentation_time(t);
+            if (presented_us == 0) return true;
+            latency.present.add(presented_us - f.draw_ns / 1000.0);
+            latency.total.add(presented_us - f.arrival_ns / 1000.0 + f.stream_us);
+            return true;
+        };
+        in_flight.erase(std::remove_if(in_flight.begin(), in_flight.end(), done), in_flight.end());
+    }
+
+    // Where things go at the current allocation; every bar uses the same.
+    struct Geometry {
+        int width, height;
+        int bar_width, gap, left;
+        int img_size; // sprite edge, 0 = no sprites
+    };
+
+    // One bar as last queued for drawing, in widget pixels.
+    struct BarShape {
+        int top;      // bar top edge
+        int sprite_y; // sprite top edge, kNoSprite when there's none
+        uint8_t color; // Palette index
+    };
+
+    static constexpr int kNoSprite = INT_MIN;
+    static constexpr int kHighlightPx = BarRaster::kHighlightPx;
+    // Bars and sprites that moved less than this keep their old shape until
+    // they do, so slow drift doesn't damage a column every frame.
+    static constexpr int kDamagePx = 2;
+    // Likewise for color: a repaint takes the whole bar, so the color stays
+    // until it is this many palette steps off (1/32 of the gradient).
+    static constexpr int kDamageColor = Palette::kSize / 32;
+
+    std::vector<BarShape> shapes;
+    int shapes_width = -1, shapes_height = -1;
+    bool showing_no_audio = false;
+    bool fresh_levels = false; // the last tick brought new analysis levels
+    bool fresh_audio = false;  // ... or consumed new audio
+    uint64_t damage_frames = 0;
+    uint64_t damage_px = 0; // area queued for redraw, summed over frames
+
+    Geometry geometry() const {
+        Geometry g;
+        g.width = get_allocated_width();
+        g.height = get_allocated_height();
+        g.bar_width = g.width / bar_count;
+        g.gap = std::min(12, g.bar_width / 3); // keep narrow bars visible at high counts
+        g.left = centered ? (g.width - g.bar_width * bar_count + g.gap) / 2 : 0;
+        g.img_size = sprites ? std::max(0, std::min(g.bar_width - g.gap, 40)) : 0;
+        return g;
+    }
+
+    BarShape shape_of(int i, const Geometry& g) const {
+        float stretched = std::min(1.0f, bands[i] * (1.0f + kPulseStretch * pulse));
+        float bar_height = std::max(2.0f, stretched * g.height);
+        BarShape s;
+        s.top = g.height - bar_height;
+
+        s.color = Palette::index(bar_height / g.height);
+
+        // Image ABOVE the bar if there's space, 4px padding
+        s.sprite_y = kNoSprite;
+        if (g.img_size > 0 && bar_height > 10) {
+            int y = s.top - g.img_size - 4 - (int)(kBouncePx * pulse);
+            if (y > 0) s.sprite_y = y;
+        }
+        return s;
+    }
+
+    bool is_quiet() const { return !is_live() || level <= 0.001f; }
+
+    // Recomputes every shape when the allocation changed; returns whether it did.
+    bool relayout(const Geometry& g) {
+        if (g.width == shapes_width && g.height == shapes_height && (int)shapes.size() == bar_count) return false;
+        shapes_width = g.width;
+        shapes_height = g.height;
+        shapes.resize(bar_count);
+        for (int i = 0; i < bar_count; ++i) shapes[i] = shape_of(i, g);
+        return true;
+    }
+
+    // Queues redraws for just the columns whose bar or sprite moved, plus the
+    // "No audio" text when it comes or goes. Each column's damage spans the
+    // old and new bar tops and sprites; a color change takes the whole bar.
+    void queue_damage() {
+        Geometry g = geometry();
+        ++damage_frames;
+        if (relayout(g)) {
+            showing_no_audio = is_quiet();
+            queue_draw();
+            damage_px += (uint64_t)g.width * g.height;
+            return;
+        }
+        for (int i = 0; i < bar_count; ++i) {
+            BarShape s = shape_of(i, g);
+            BarShape& old = shapes[i];
+            if (std::abs(s.color - old.color) < kDamageColor) s.color = old.color;
+            bool moved = std::abs(s.top - old.top) >= kDamagePx || s.color != old.color
+                      || (s.sprite_y == kNoSprite) != (old.sprite_y == kNoSprite)
+                      || (s.sprite_y != kNoSprite && std::abs(s.sprite_y - old.sprite_y) >= kDamagePx);
+            if (!moved) continue;
+
+            int y0 = std::min(s.top, old.top);
+            int y1 = s.color != old.color ? g.height : std::max(s.top, old.top) + kHighlightPx;
+            for (const BarShape* b : {&s, &old}) {
+                if (b->sprite_y == kNoSprite) continue;
+                y0 = std::min(y0, b->sprite_y);
+                y1 = std::max(y1, b->sprite_y + g.img_size);
+            }
+            y1 = std::min(y1, g.height);
+            queue_draw_area(g.left + i * g.bar_width, y0, g.bar_width, y1 - y0);
+            damage_px += (uint64_t)g.bar_width * (y1 - y0);
+            old = s;
+        }
+        if (is_quiet() != showing_no_audio) {
+            showing_no_audio = is_quiet();
+            queue_draw_area(g.width - kNoAudioWidth, 0, kNoAudioWidth, kNoAudioHeight);
+            damage_px += kNoAudioWidth * kNoAudioHeight;
+        }
+    }
+
+    static constexpr int kNoAudioWidth = 124;
+    static constexpr int kNoAudioHeight = 28;
+
+    // The ring's rows head..end go at the top, 0..head below them.
+    void draw_waterfall(const Cairo::RefPtr<Cairo::Context>& cr, const Geometry& g) {
+        int scale = get_scale_factor();
+        int width = g.width * scale, rows = g.height * scale;
+        if (!waterfall_pixels || waterfall_pixels->get_width() != width || waterfall_pixels->get_height() != rows) {
+            waterfall_pixels = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, width, rows);
+            waterfall.layout(bar_count, width, rows);
+        }
+        int head = waterfall.get_head();
+        cr->save();
+        cr->scale(1.0 / scale, 1.0 / scale);
+        cr->set_operator(Cairo::OPERATOR_SOURCE);
+        cr->set_source(waterfall_pixels, 0, -head);
+        cr->rectangle(0, 0, width, rows - head);
+        cr->fill();
+        cr->set_source(waterfall_pixels, 0, rows - head);
+        cr->rectangle(0, rows - head, width, head);
+        cr->fill();
+        cr->restore();
+    }
+
+    void draw_scope(const Cairo::RefPtr<Cairo::Context>& cr, const Geometry& g) {
+        int scale = get_scale_factor();
+        if (!scope_pixels || scope_pixels->get_width() != g.width * scale || scope_pixels->get_height() != g.height * scale) {
+            scope_pixels = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, g.width * scale, g.height * scale);
+            cairo_surface_set_device_scale(scope_pixels->cobj(), scale, scale);
+            scope.layout(g.width * scale, g.height * scale, meter->get_rate() * frame_interval_us / 1000000);
+            scope_history.resize(scope.get_history());
+            render_scope();
+        }
+        cr->save();
+        cr->set_operator(Cairo::OPERATOR_SOURCE);
+        cr->set_source(scope_pixels, 0, 0);
+        cr->paint();
+        cr->restore();
+    }
+
+    // Bars come off the layout's tables, one filled quad each; the sprite
+    // sits in the middle and bounces with the beat.
+    void draw_radial(const Cairo::RefPtr<Cairo::Context>& cr, const Geometry& g) {
+        if (g.width != radial_width || g.height != radial_height) {
+            radial.layout(bar_count, g.width, g.height);
+            radial_width = g.width;
+            radial_height = g.height;
+        }
+        cr->save();
+        cr->set_operator(Cairo::OPERATOR_SOURCE);
+        cr->set_source_rgba(0.0, 0.0, 0.0, 0.0);
+        cr->paint();
+        cr->restore();
+
+        for (int i = 0; i < bar_count; ++i) {
+            float stretched = std::min(1.0f, bands[i] * (1.0f + kPulseStretch * pulse));
+            RadialLayout::Quad q = radial.quad(i, stretched);
+            const BarColor& c = palette.color(Palette::index(stretched));
+            cr->set_source_rgba(c.r, c.g, c.b, c.a);
+            cr->move_to(q.x[0], q.y[0]);
+            for (int k = 1; k < 4; ++k) cr->line_to(q.x[k], q.y[k]);
+            cr->close_path();
+            cr->fill();
+        }
+
+        int size = sprites ? std::min(40, (int)(radial.get_inner() * 1.2f)) : 0;
+        if (size <= 0) return;
+        Cairo::RefPtr<Cairo::Surface> sprite = sprites.get(size, get_scale_factor(), get_window()->gobj());
+        int x = (int)radial.get_center_x() - size / 2;
+        int y = (int)radial.get_center_y() - size / 2 - (int)(kBouncePx * pulse);
+        cr->set_source(sprite, x, y);
+        cr->rectangle(x, y, size, size);
+        cr->fill();
+    }
+
+    void draw_no_audio(const Cairo::RefPtr<Cairo::Context>& cr, const Geometry& g) {
+        cr->set_source_rgba(1.0, 0.6, 0.8, 0.8);
+        cr->select_font_face("sans", Cairo::FONT_SLANT_NORMAL, Cairo::FONT_WEIGHT_NORMAL);
+        cr->set_font_size(12);
+        cr->move_to(g.width - 120, 20);
+        cr->show_text("No audio");
+    }
+
+    // Bars go through the retained rasterizer into bar_pixels, which is then
+    // composited over the damaged clip in one paint (SOURCE, so it clears
+    // too). Sprites and text still go through Cairo, only inside the clip.
+    bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override {
+        note_draw(steady_now_ns());
+        Geometry g = geometry();
+        if (mode == ViewMode::Waterfall) {
+            draw_waterfall(cr, g);
+            if (showing_no_audio) draw_no_audio(cr, g);
+            return true;
+        }
+        if (mode == ViewMode::Radial) {
+            draw_radial(cr, g);
+            if (showing_no_audio) draw_no_audio(cr, g);
+            return true;
+        }
+        if (mode == ViewMode::Scope) {
+            draw_scope(cr, g);
+            if (showing_no_audio) draw_no_audio(cr, g);
+            return true;
+        }
+        relayout(g);
+        int scale = get_scale_factor();
+        if (!bar_pixels || bar_pixels->get_width() != g.width * scale || bar_pixels->get_height() != g.height * scale) {
+            bar_pixels = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, g.width * scale, g.height * scale);
+            cairo_surface_set_device_scale(bar_pixels->cobj(), scale, scale);
+            bar_raster.layout(bar_count, g.left, g.bar_width, g.bar_width - g.gap, g.width, g.height, scale);
+        }
+        bar_pixels->flush();
+        unsigned char* pixels = bar_pixels->get_data();
+        bool dirty = false;
+        for (int i = 0; i < bar_count; ++i) {
+            dirty |= bar_raster.set(pixels, bar_pixels->get_stride(), i, shapes[i].top, shapes[i].color);
+        }
+        if (dirty) bar_pixels->mark_dirty();
+
+        cr->save();
+        cr->set_operator(Cairo::OPERATOR_SOURCE);
+        cr->set_source(bar_pixels, 0, 0);
+        cr->paint();
+        cr->restore();
+
+        Cairo::RefPtr<Cairo::Surface> sprite;
+        if (g.img_size > 0) sprite = sprites.get(g.img_size, scale, get_window()->gobj());
+        if (sprite) {
+            double x1, y1, x2, y2;
+            cr->get_clip_extents(x1, y1, x2, y2);
+            int first = std::max(0, ((int)x1 - g.left) / std::max(1, g.bar_width));
+            int last = std::min(bar_count - 1, ((int)x2 - g.left) / std::max(1, g.bar_width));
+            for (int i = first; i <= last; ++i) {
+                if (shapes[i].sprite_y == kNoSprite) continue;
+                int img_x = g.left + i * g.bar_width + (g.bar_width - g.img_size) / 2;
+                cr->set_source(sprite, img_x, shapes[i].sprite_y);
+                cr->rectangle(img_x, shapes[i].sprite_y, g.img_size, g.img_size);
+                cr->fill();
+            }
+        }
+
+        if (showing_no_audio) draw_no_audio(cr, g);
+
+        return true;
+    }
+};
+
+class App : public Gtk::Application {
+public:
+    // Sharing means several instances on purpose, so they must not collapse
+    // into one through GApplication's uniqueness.
+    App(const Theme& t, const VisualizerConfig& c)
+        : Gtk::Application("org.elysia.Visualizer", c.share == ShareMode::Off ? Gio::APPLICATION_FLAGS_NONE
+                                                                              : Gio::APPLICATION_NON_UNIQUE),
+          theme(t), config(c) {}
+
+    void on_activate() override {
+        Visualizer* vis = nullptr;
+        if (config.share == ShareMode::Subscribe) {
+            subscriber = SpectrumSubscriber::open();
+            if (subscriber) vis = new Visualizer(*subscriber, theme, config);
+            else std::cerr << "No visualizer is publishing its spectrum, capturing here instead\n";
+        }
+        if (!vis) {
+            meter = open_capture(config);
+            if (config.share == ShareMode::Publish) publisher = SpectrumPublisher::create();
+            vis = new Visualizer(*meter, theme, config, publisher.get());
+        }
+
+        auto* window = new Gtk::Window();
+        window->set_default_size(-1, 200);
+        window->set_decorated(false);
+        window->set_opacity(0.9);
+        window->set_accept_focus(false);
+        window->set_app_paintable(true);
+
+        auto screen = window->get_screen();
+        auto visual = screen->get_rgba_visual();
+        if (visual) {
+            gtk_widget_set_visual(GTK_WIDGET(window->gobj()), visual->gobj());
+        }
+
+        GtkWindow* gtk_win = GTK_WINDOW(window->gobj());
+        gtk_layer_init_for_window(gtk_win);
+        gtk_layer_set_layer(gtk_win, GTK_LAYER_SHELL_LAYER_BOTTOM);
+        gtk_layer_set_anchor(gtk_win, GTK_LAYER_SHELL_EDGE_BOTTOM, true);
+        gtk_layer_set_anchor(gtk_win, GTK_LAYER_SHELL_EDGE_LEFT, true);
+        gtk_layer_set_anchor(gtk_win, GTK_LAYER_SHELL_EDGE_RIGHT, true);
+        gtk_layer_set_margin(gtk_win, GTK_LAYER_SHELL_EDGE_BOTTOM, 0);
+
+        window->add(*vis);
+
+        // kill -USR1 dumps the counters and latency histograms on demand.
+        g_unix_signal_add(SIGUSR1, [](gpointer data) -> gboolean {
+            static_cast<Visualizer*>(data)->dump_stats(std::cerr);
+            return G_SOURCE_CONTINUE;
+        }, vis);
+
+        // Ctrl-C and kill end the main loop instead of the process, so capture
+        // (with a recording's final flush) and a shared segment shut down
+        // through their destructors.
+        for (int sig : {SIGINT, SIGTERM}) {
+            g_unix_signal_add(sig, [](gpointer data) -> gboolean {
+                static_cast<App*>(data)->quit();
+                return G_SOURCE_REMOVE;
+            }, this);
+        }
+
+        if (config.stats_interval > 0) {
+            Glib::signal_timeout().connect_seconds([vis]() {
+                vis->dump_stats(std::cerr);
+                return true;
+            }, config.stats_interval);
+        }
+
+        add_window(*window);
+        window->show_all();
+    }
+
+private:
+    Theme theme;
+    VisualizerConfig config;
+    std::unique_ptr<CaptureBackend> meter;
+    std::unique_ptr<SpectrumPublisher> publisher;
+    std::unique_ptr<SpectrumSubscriber> subscriber;
+};
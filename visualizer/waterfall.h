@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "bar_raster.h"
+#include "palette.h"
+
+// Scrolling spectrogram. Every analysis update becomes one pixel row, newest
+// at the top, older rows sliding down. History lives in a ring of rows in a
+// pixel buffer (ARGB32, like BarRaster): a new row overwrites the oldest one
+// and moves the head, nothing is shifted or redrawn. The screen shows rows
+// head..end then 0..head, which the widget composites as two rectangles, so
+// the work per update is one row whatever the history length.
+class Waterfall {
+public:
+    // Colors come from the bar palette, faded out towards silence so quiet
+    // bins stay transparent over the desktop.
+    explicit Waterfall(const Palette& palette) : fill(raster::best_fill()) {
+        for (int i = 0; i < Palette::kSize; ++i) {
+            uint32_t c = palette.fill((uint8_t)i), scaled = 0;
+            for (int shift = 0; shift < 32; shift += 8) scaled |= ((c >> shift & 0xff) * i / 255) << shift;
+            colors[i] = scaled;
+        }
+    }
+
+    // Device pixels. Precomputes which bar every column shows, as runs of
+    // columns per bar, and forgets the history: pair it with a fresh,
+    // transparent buffer.
+    void layout(int bar_count, int width, int rows) {
+        this->rows = std::max(1, rows);
+        run_start.assign(bar_count + 1, 0);
+        for (int b = 0; b <= bar_count; ++b) run_start[b] = (int)((int64_t)b * width / bar_count);
+        head = 0;
+    }
+
+    // Writes levels (0..1 per bar) as the newest row.
+    void push(uint8_t* pixels, int stride, const float* levels) {
+        head = head == 0 ? rows - 1 : head - 1;
+        uint32_t* row = reinterpret_cast<uint32_t*>(pixels + (size_t)head * stride);
+        for (size_t b = 0; b + 1 < run_start.size(); ++b) {
+            fill(row + run_start[b], run_start[b + 1] - run_start[b], colors[Palette::index(levels[b])]);
+        }
+    }
+
+    // Buffer row shown at the top of the screen.
+    int get_head() const { return head; }
+    int get_rows() const { return rows; }
+
+private:
+    std::array<uint32_t, Palette::kSize> colors;
+    raster::Fill fill;
+    std::vector<int> run_start; // first column of each bar, plus the width
+    int rows = 1;
+    int head = 0;
+};